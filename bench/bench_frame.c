@@ -0,0 +1,41 @@
+//Build: cc -O2 bench_frame.c ../src/frame.c ../lib/bench.c ../lib/get_num.c ../lib/error_functions.c -lm
+#include "../lib/tlpi_hdr.h"
+#include "../lib/bench.h"
+#include "../src/frame.h"
+
+#define WIDTH     640      //Same format g_photo requests
+#define HEIGHT    480
+
+struct input {
+   const unsigned char *yuyv;
+   double ratio;
+};
+
+void black_ratio(void *arg) {
+   struct input *in = arg;
+
+   in->ratio = frame_black_ratio(in->yuyv, WIDTH, HEIGHT);
+}
+
+int main(int argc, char *argv[]) {
+   struct benchOpts opts;
+   struct benchResult res;
+   struct input in;
+   size_t len;
+
+   benchOptsFromArgs(argc, argv, &opts);
+
+   //A captured frame.raw if given, otherwise noise (about 6% black)
+   unsigned char *yuyv = (unsigned char *)benchInput(optind < argc ? argv[optind] : NULL,
+         WIDTH * HEIGHT * 2, &len);
+   if (len < WIDTH * HEIGHT * 2)
+      fatal("frame is %zu bytes, need %d", len, WIDTH * HEIGHT * 2);
+   in.yuyv = yuyv;
+
+   if (benchRun("frame_black_ratio", black_ratio, &in, WIDTH * HEIGHT * 2, &opts, &res) == -1)
+      errExit("benchRun");
+   benchReport(stdout, &res, 1, opts.format);
+
+   free(yuyv);
+   return 0;
+}
@@ -0,0 +1,61 @@
+//Build: cc -O2 -pthread bench_io.c ../src/squeeze.c ../lib/bench.c ../lib/get_num.c ../lib/error_functions.c -lm
+#include <fcntl.h>
+#include "../lib/tlpi_hdr.h"
+#include "../lib/bench.h"
+#include "../src/squeeze.h"
+
+#define SYNTH_LEN    (64 * 1024 * 1024)
+
+struct input {
+   const char *buf;
+   size_t len;
+   char *out;
+   int null_fd;
+   int nthreads;
+};
+
+void squeeze_kernel(void *arg) {
+   struct input *in = arg;
+
+   squeeze(in->buf, in->len, in->out, 0);
+}
+
+void squeeze_pool(void *arg) {
+   struct input *in = arg;
+
+   if (squeeze_parallel(in->buf, in->len, in->null_fd, in->nthreads) == -1)
+      errExit("squeeze_parallel");
+}
+
+int main(int argc, char *argv[]) {
+   struct benchOpts opts;
+   struct benchResult res[1 + 8];
+   struct input in;
+   char names[8][32];
+   int n = 0;
+
+   benchOptsFromArgs(argc, argv, &opts);
+   char *buf = benchInput(optind < argc ? argv[optind] : NULL, SYNTH_LEN, &in.len);
+   in.buf = buf;
+   in.out = malloc(in.len);
+   in.null_fd = open("/dev/null", O_WRONLY);
+   if (in.out == NULL || in.null_fd == -1)
+      errExit("setting up io benchmark");
+
+   if (benchRun("squeeze", squeeze_kernel, &in, in.len, &opts, &res[n++]) == -1)
+      errExit("benchRun");
+
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   for (int t = 1, j = 0; t <= cpus && t <= MAX_THREADS && j < 8; t *= 2, ++j) {
+      in.nthreads = t;
+      snprintf(names[j], sizeof(names[j]), "squeeze_parallel/%d", t);
+      if (benchRun(names[j], squeeze_pool, &in, in.len, &opts, &res[n++]) == -1)
+         errExit("benchRun");
+   }
+   benchReport(stdout, res, n, opts.format);
+
+   close(in.null_fd);
+   free(in.out);
+   free(buf);
+   return 0;
+}
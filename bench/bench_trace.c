@@ -0,0 +1,41 @@
+//Build: cc -O2 -DTLPI_TRACE bench_trace.c ../lib/trace.c ../lib/bench.c ../lib/get_num.c ../lib/error_functions.c -lm -pthread
+#include "../lib/tlpi_hdr.h"
+#include "../lib/bench.h"
+#include "../lib/trace.h"
+
+#define POINTS    1000000   //Trace points per iteration
+
+void empty_loop(void *arg) {
+   volatile long *sink = arg;
+
+   for (long i = 0; i < POINTS; ++i)
+      *sink += i;
+}
+
+void traced_loop(void *arg) {
+   volatile long *sink = arg;
+
+   for (long i = 0; i < POINTS; ++i) {
+      TRACE_SCOPE("point");
+      *sink += i;
+   }
+}
+
+int main(int argc, char *argv[]) {
+   struct benchOpts opts;
+   struct benchResult res[2];
+   long sink = 0;
+
+   benchOptsFromArgs(argc, argv, &opts);
+
+   if (benchRun("empty_loop", empty_loop, &sink, 0, &opts, &res[0]) == -1 ||
+         benchRun("traced_loop", traced_loop, &sink, 0, &opts, &res[1]) == -1)
+      errExit("benchRun");
+   benchReport(stdout, res, 2, opts.format);
+   printf("Overhead: %.2f ns per trace point\n",
+         (res[1].medianNs - res[0].medianNs) / POINTS);
+
+   if (optind < argc && traceWrite(argv[optind]) == -1)
+      errExit("traceWrite %s", argv[optind]);
+   return 0;
+}
@@ -0,0 +1,37 @@
+//Build: cc -O2 bench_wc.c ../src/wc_count.c ../lib/bench.c ../lib/get_num.c ../lib/error_functions.c -lm
+#include "../lib/tlpi_hdr.h"
+#include "../lib/bench.h"
+#include "../src/wc_count.h"
+
+#define SYNTH_LEN    (64 * 1024 * 1024)
+
+struct input {
+   const char *buf;
+   size_t len;
+   long words;
+};
+
+void count_words(void *arg) {
+   struct input *in = arg;
+   struct wc_counts c = {0, 0, 0, OUT};
+
+   wc_count(in->buf, in->len, &c);
+   in->words = c.words;
+}
+
+int main(int argc, char *argv[]) {
+   struct benchOpts opts;
+   struct benchResult res;
+   struct input in;
+
+   benchOptsFromArgs(argc, argv, &opts);
+   char *buf = benchInput(optind < argc ? argv[optind] : NULL, SYNTH_LEN, &in.len);
+   in.buf = buf;
+
+   if (benchRun("wc_count", count_words, &in, in.len, &opts, &res) == -1)
+      errExit("benchRun");
+   benchReport(stdout, &res, 1, opts.format);
+
+   free(buf);
+   return 0;
+}
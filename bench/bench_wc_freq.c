@@ -0,0 +1,82 @@
+//Build: cc -O2 bench_wc_freq.c ../src/word_freq.c ../lib/bench.c ../lib/get_num.c ../lib/error_functions.c -lm
+#include <limits.h>
+#include "../lib/tlpi_hdr.h"
+#include "../lib/bench.h"
+#include "../src/word_freq.h"
+
+#define SYNTH_LEN    (64 * 1024 * 1024)
+#define TOP_N        10
+
+struct input {
+   const char *buf;
+   size_t len;
+   size_t mem_limit;
+   const char *path;          //Same text on disk, for the shell pipeline
+   char command[PATH_MAX + 128];
+};
+
+void count_freq(void *arg) {
+   struct input *in = arg;
+   struct word_count top[TOP_N];
+
+   struct word_freq *wf = word_freq_create(in->mem_limit, TOP_N);
+   if (wf == NULL || word_freq_feed(wf, in->buf, in->len) == -1 || word_freq_finish(wf) == -1)
+      errExit("word_freq");
+   word_freq_top(wf, top);
+   word_freq_destroy(wf);
+}
+
+void count_pipeline(void *arg) {
+   struct input *in = arg;
+
+   if (system(in->command) != 0)
+      fatal("pipeline failed: %s", in->command);
+}
+
+int main(int argc, char *argv[]) {
+   struct benchOpts opts;
+   struct benchResult res[3];
+   struct input in;
+   char tmp[] = "/tmp/bench_wc_freq_XXXXXX";
+   int n = 0;
+
+   benchOptsFromArgs(argc, argv, &opts);
+   in.path = optind < argc ? argv[optind] : NULL;
+   char *buf = benchInput(in.path, SYNTH_LEN, &in.len);
+   in.buf = buf;
+
+   //The pipeline needs a file to read
+   if (in.path == NULL) {
+      int fd = mkstemp(tmp);
+      if (fd == -1)
+         errExit("mkstemp");
+      if (write(fd, buf, in.len) != (ssize_t)in.len)
+         errExit("write");
+      close(fd);
+      in.path = tmp;
+   }
+   snprintf(in.command, sizeof(in.command),
+         "LC_ALL=C tr -s ' \\t' '\\n\\n' < '%s' | LC_ALL=C sort | uniq -c | "
+         "sort -rn | head -%d > /dev/null", in.path, TOP_N);
+
+   in.mem_limit = 0;
+   if (benchRun("word_freq", count_freq, &in, in.len, &opts, &res[n++]) == -1)
+      errExit("benchRun");
+   in.mem_limit = 8 * 1024 * 1024;
+   if (benchRun("word_freq -m 8", count_freq, &in, in.len, &opts, &res[n++]) == -1)
+      errExit("benchRun");
+
+   //The pipeline is slow enough that a couple of runs tell the story
+   struct benchOpts pipe_opts = opts;
+   pipe_opts.warmup = 0;
+   pipe_opts.iterations = opts.iterations < 3 ? opts.iterations : 3;
+   if (benchRun("tr|sort|uniq -c|sort", count_pipeline, &in, in.len, &pipe_opts, &res[n++]) == -1)
+      errExit("benchRun");
+
+   benchReport(stdout, res, n, opts.format);
+
+   if (in.path == tmp)
+      unlink(tmp);
+   free(buf);
+   return 0;
+}
@@ -0,0 +1,323 @@
+/* bench.c
+
+   A small benchmark harness for the programs in src/.
+
+   benchRun() calls a function a number of untimed warmup times, then
+   times each of a number of iterations with CLOCK_MONOTONIC_RAW (which
+   is immune to NTP slewing) and summarizes the distribution. Where the
+   kernel permits it (see perf_event_paranoid), cycles, instructions,
+   cache misses and branch misses for the timed iterations are counted
+   with perf_event_open(2); otherwise the counters are reported as
+   unavailable rather than failing the run. The counters are inherited,
+   so they include any threads the benchmarked function creates.
+
+   benchReport() prints results as an aligned table, CSV or JSON.
+*/
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "bench.h"
+#include "tlpi_hdr.h"
+
+#define NCOUNTERS 4
+
+static const uint64_t counterConfig[NCOUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/* Fill in 'opts' from the -w (warmup), -n (iterations) and -f (format)
+   options, leaving 'optind' at the first non-option argument */
+
+void
+benchOptsFromArgs(int argc, char *argv[], struct benchOpts *opts)
+{
+    int opt;
+
+    opts->warmup = 3;
+    opts->iterations = 20;
+    opts->format = BENCH_TEXT;
+
+    while ((opt = getopt(argc, argv, "w:n:f:")) != -1) {
+        switch (opt) {
+        case 'w':
+            opts->warmup = getInt(optarg, GN_NONNEG, "warmup");
+            break;
+        case 'n':
+            opts->iterations = getInt(optarg, GN_GT_0, "iterations");
+            break;
+        case 'f':
+            if (strcmp(optarg, "text") == 0)
+                opts->format = BENCH_TEXT;
+            else if (strcmp(optarg, "csv") == 0)
+                opts->format = BENCH_CSV;
+            else if (strcmp(optarg, "json") == 0)
+                opts->format = BENCH_JSON;
+            else
+                cmdLineErr("unknown format '%s'\n", optarg);
+            break;
+        default:
+            usageErr("%s [-w warmup] [-n iterations] [-f text|csv|json] "
+                    "[args...]\n", argv[0]);
+        }
+    }
+}
+
+static double
+nowNs(void)
+{
+    return benchNow() * 1e9;
+}
+
+/* Open the counters as one group led by the cycle counter, so they are
+   scheduled onto the PMU together. 'inherit' extends them to threads
+   created after this point, and a group read then sums over those
+   threads, including ones that have already exited. Threads that were
+   already running are not counted. Returns the leader fd, or -1. */
+
+static int
+openCounters(int fds[NCOUNTERS])
+{
+    struct perf_event_attr attr;
+    int j;
+
+    for (j = 0; j < NCOUNTERS; j++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counterConfig[j];
+        attr.disabled = (j == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        fds[j] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                         j == 0 ? -1 : fds[0], 0);
+        if (fds[j] == -1) {
+            while (--j >= 0)
+                close(fds[j]);
+            return -1;
+        }
+    }
+    return fds[0];
+}
+
+static void
+closeCounters(int fds[NCOUNTERS])
+{
+    int j;
+
+    for (j = 0; j < NCOUNTERS; j++)
+        close(fds[j]);
+}
+
+static int
+cmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Run 'fn(arg)' as described by 'opts' and summarize the timings in
+   'res'. 'bytes' is the amount of data one call processes, used to
+   report throughput (0 if not meaningful). Returns 0 on success, or
+   -1 if memory for the samples could not be allocated. */
+
+int
+benchRun(const char *name, benchFn fn, void *arg, size_t bytes,
+        const struct benchOpts *opts, struct benchResult *res)
+{
+    int fds[NCOUNTERS], leader, j;
+    uint64_t values[1 + NCOUNTERS];
+    double *samples, t, sum = 0, sq = 0;
+
+    memset(res, 0, sizeof(*res));
+    res->name = name;
+    res->iterations = opts->iterations;
+    res->bytes = bytes;
+
+    samples = malloc(opts->iterations * sizeof(double));
+    if (samples == NULL)
+        return -1;
+
+    for (j = 0; j < opts->warmup; j++)
+        fn(arg);
+
+    leader = openCounters(fds);
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    for (j = 0; j < opts->iterations; j++) {
+        t = nowNs();
+        fn(arg);
+        samples[j] = nowNs() - t;
+    }
+
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        /* Group read: the counter count, then each value in order */
+        if (read(leader, values, sizeof(values)) == sizeof(values) &&
+                values[0] == NCOUNTERS) {
+            res->counters.valid = true;
+            res->counters.cycles = (double) values[1] / opts->iterations;
+            res->counters.instructions = (double) values[2] / opts->iterations;
+            res->counters.cacheMisses = (double) values[3] / opts->iterations;
+            res->counters.branchMisses = (double) values[4] / opts->iterations;
+        }
+        closeCounters(fds);
+    }
+
+    for (j = 0; j < opts->iterations; j++) {
+        sum += samples[j];
+        sq += samples[j] * samples[j];
+    }
+    qsort(samples, opts->iterations, sizeof(double), cmpDouble);
+
+    res->minNs = samples[0];
+    res->maxNs = samples[opts->iterations - 1];
+    res->medianNs = (opts->iterations % 2) ? samples[opts->iterations / 2] :
+            (samples[opts->iterations / 2 - 1] +
+             samples[opts->iterations / 2]) / 2;
+    res->meanNs = sum / opts->iterations;
+    res->stddevNs = sqrt(fmax(0, sq / opts->iterations -
+                                 res->meanNs * res->meanNs));
+
+    free(samples);
+    return 0;
+}
+
+/* Return a malloc()ed copy of the file 'path' or, if 'path' is NULL,
+   'synthLen' bytes of deterministic text made of short words separated
+   by runs of spaces, tabs and newlines. The length goes in '*len'.
+   Terminates the process on error. */
+
+char *
+benchInput(const char *path, size_t synthLen, size_t *len)
+{
+    static const char seps[] = "  \t\n";
+    char *buf;
+    size_t j;
+    uint32_t x = 2463534242u;   /* xorshift32 state */
+    FILE *fp;
+
+    if (path != NULL) {
+        fp = fopen(path, "rb");
+        if (fp == NULL)
+            errExit("fopen %s", path);
+        if (fseek(fp, 0, SEEK_END) == -1)
+            errExit("fseek %s", path);
+        *len = ftell(fp);
+        rewind(fp);
+        buf = malloc(*len + 1);
+        if (buf == NULL)
+            errExit("malloc");
+        if (fread(buf, 1, *len, fp) != *len)
+            errExit("fread %s", path);
+        fclose(fp);
+        return buf;
+    }
+
+    buf = malloc(synthLen + 1);
+    if (buf == NULL)
+        errExit("malloc");
+    for (j = 0; j < synthLen; j++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[j] = (x % 6 == 0) ? seps[(x >> 8) % 4] :
+                                (char) ('a' + (x >> 8) % 26);
+    }
+    *len = synthLen;
+    return buf;
+}
+
+/* Throughput at the median, in MB/s, or 0 if 'bytes' was not given */
+
+static double
+mbPerSec(const struct benchResult *r)
+{
+    return (r->bytes && r->medianNs > 0) ? r->bytes / r->medianNs * 1e3 : 0;
+}
+
+void
+benchReport(FILE *fp, const struct benchResult *res, int n,
+        enum benchFormat format)
+{
+    const struct benchResult *r;
+    int j;
+
+    switch (format) {
+    case BENCH_TEXT:
+        fprintf(fp, "%-24s %6s %12s %12s %10s %10s %14s %8s %12s %12s\n",
+                "name", "iters", "median(ns)", "mean(ns)", "stddev%",
+                "MB/s", "cycles", "IPC", "cache-miss", "branch-miss");
+        for (j = 0; j < n; j++) {
+            r = &res[j];
+            fprintf(fp, "%-24s %6d %12.0f %12.0f %9.1f%% %10.1f ",
+                    r->name, r->iterations, r->medianNs, r->meanNs,
+                    r->meanNs > 0 ? 100 * r->stddevNs / r->meanNs : 0,
+                    mbPerSec(r));
+            if (r->counters.valid)
+                fprintf(fp, "%14.0f %8.2f %12.0f %12.0f\n",
+                        r->counters.cycles,
+                        r->counters.instructions / r->counters.cycles,
+                        r->counters.cacheMisses, r->counters.branchMisses);
+            else
+                fprintf(fp, "%14s %8s %12s %12s\n", "n/a", "n/a", "n/a",
+                        "n/a");
+        }
+        break;
+
+    case BENCH_CSV:
+        fprintf(fp, "name,iterations,bytes,min_ns,median_ns,mean_ns,"
+                "stddev_ns,max_ns,mb_per_s,cycles,instructions,"
+                "cache_misses,branch_misses\n");
+        for (j = 0; j < n; j++) {
+            r = &res[j];
+            fprintf(fp, "%s,%d,%zu,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,",
+                    r->name, r->iterations, r->bytes, r->minNs,
+                    r->medianNs, r->meanNs, r->stddevNs, r->maxNs,
+                    mbPerSec(r));
+            if (r->counters.valid)
+                fprintf(fp, "%.0f,%.0f,%.0f,%.0f\n", r->counters.cycles,
+                        r->counters.instructions, r->counters.cacheMisses,
+                        r->counters.branchMisses);
+            else
+                fprintf(fp, ",,,\n");
+        }
+        break;
+
+    case BENCH_JSON:
+        fprintf(fp, "[\n");
+        for (j = 0; j < n; j++) {
+            r = &res[j];
+            fprintf(fp, "  {\"name\": \"%s\", \"iterations\": %d, "
+                    "\"bytes\": %zu, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+                    "\"mean_ns\": %.0f, \"stddev_ns\": %.0f, "
+                    "\"max_ns\": %.0f, \"mb_per_s\": %.1f, ",
+                    r->name, r->iterations, r->bytes, r->minNs,
+                    r->medianNs, r->meanNs, r->stddevNs, r->maxNs,
+                    mbPerSec(r));
+            if (r->counters.valid)
+                fprintf(fp, "\"counters\": {\"cycles\": %.0f, "
+                        "\"instructions\": %.0f, \"cache_misses\": %.0f, "
+                        "\"branch_misses\": %.0f}}",
+                        r->counters.cycles, r->counters.instructions,
+                        r->counters.cacheMisses, r->counters.branchMisses);
+            else
+                fprintf(fp, "\"counters\": null}");
+            fprintf(fp, "%s\n", j + 1 < n ? "," : "");
+        }
+        fprintf(fp, "]\n");
+        break;
+    }
+}
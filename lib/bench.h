@@ -0,0 +1,72 @@
+/* bench.h
+
+   Header file for bench.c.
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+enum benchFormat {
+    BENCH_TEXT,
+    BENCH_CSV,
+    BENCH_JSON
+};
+
+struct benchOpts {
+    int warmup;                 /* Untimed runs before measuring */
+    int iterations;             /* Timed runs */
+    enum benchFormat format;
+};
+
+/* Hardware counters, averaged per iteration */
+
+struct benchCounters {
+    bool valid;                 /* False if perf_event_open() was refused */
+    double cycles;
+    double instructions;
+    double cacheMisses;
+    double branchMisses;
+};
+
+struct benchResult {
+    const char *name;
+    int iterations;
+    size_t bytes;               /* Bytes processed per iteration, or 0 */
+    double minNs;
+    double medianNs;
+    double meanNs;
+    double stddevNs;
+    double maxNs;
+    struct benchCounters counters;
+};
+
+typedef void (*benchFn)(void *arg);
+
+/* Seconds on CLOCK_MONOTONIC_RAW. Also the clock for quick one-off
+   timings in tools that don't need the full harness. Being inline, it
+   needs no other part of lib/ linked in. */
+
+static inline double
+benchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void benchOptsFromArgs(int argc, char *argv[], struct benchOpts *opts);
+
+int benchRun(const char *name, benchFn fn, void *arg, size_t bytes,
+        const struct benchOpts *opts, struct benchResult *res);
+
+char *benchInput(const char *path, size_t synthLen, size_t *len);
+
+void benchReport(FILE *fp, const struct benchResult *res, int n,
+        enum benchFormat format);
+
+#endif
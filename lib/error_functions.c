@@ -19,6 +19,16 @@
 #include "tlpi_hdr.h"
 #include "ename.c.inc"          /* Defines ename and MAX_ENAME */
 
+/* logFlush() is only present if the program links log_functions.c;
+   a weak reference lets these routines work either way */
+
+#ifdef __GNUC__
+void logFlush(void) __attribute__ ((weak));
+#define flushLog() do { if (logFlush != NULL) logFlush(); } while (0)
+#else
+#define flushLog() do { } while (0)
+#endif
+
 NORETURN
 static void
 terminate(Boolean useExit3)
@@ -105,6 +115,8 @@ errExit(const char *format, ...)
 {
     va_list argList;
 
+    flushLog();               /* Queued log messages come first */
+
     va_start(argList, format);
     outputError(TRUE, errno, TRUE, format, argList);
     va_end(argList);
@@ -147,6 +159,8 @@ errExitEN(int errnum, const char *format, ...)
 {
     va_list argList;
 
+    flushLog();               /* Queued log messages come first */
+
     va_start(argList, format);
     outputError(TRUE, errnum, TRUE, format, argList);
     va_end(argList);
@@ -161,6 +175,8 @@ fatal(const char *format, ...)
 {
     va_list argList;
 
+    flushLog();               /* Queued log messages come first */
+
     va_start(argList, format);
     outputError(FALSE, 0, TRUE, format, argList);
     va_end(argList);
@@ -175,6 +191,7 @@ usageErr(const char *format, ...)
 {
     va_list argList;
 
+    flushLog();               /* Queued log messages come first */
     fflush(stdout);           /* Flush any pending stdout */
 
     fprintf(stderr, "Usage: ");
@@ -194,6 +211,7 @@ cmdLineErr(const char *format, ...)
 {
     va_list argList;
 
+    flushLog();               /* Queued log messages come first */
     fflush(stdout);           /* Flush any pending stdout */
 
     fprintf(stderr, "Command-line usage error: ");
@@ -17,6 +17,8 @@
 #ifndef GET_NUM_H
 #define GET_NUM_H
 
+#include <stddef.h>             /* For size_t */
+
 #define GN_NONNEG       01      /* Value must be >= 0 */
 #define GN_GT_0         02      /* Value must be > 0 */
 
@@ -29,4 +31,22 @@ long getLong(const char *arg, int flags, const char *name);
 
 int getInt(const char *arg, int flags, const char *name);
 
+/* Bulk parsing of delimiter-separated numbers (get_num_bulk.c). These
+   honor the GN_* flags above but return one of the following status
+   codes instead of terminating the process. */
+
+#define GN_OK            0      /* All tokens parsed (or 'max' reached) */
+#define GN_ERR_SYNTAX   -1      /* Nonnumeric characters in a token */
+#define GN_ERR_RANGE    -2      /* Value out of range for the type */
+#define GN_ERR_NEG      -3      /* Negative value with GN_NONNEG */
+#define GN_ERR_NOT_GT_0 -4      /* Value <= 0 with GN_GT_0 */
+
+int getLongs(const char *buf, size_t len, const char *delims, int flags,
+        long *out, size_t max, size_t *count, size_t *consumed);
+
+int getDoubles(const char *buf, size_t len, const char *delims, int flags,
+        double *out, size_t max, size_t *count, size_t *consumed);
+
+const char *gnStrError(int status);
+
 #endif
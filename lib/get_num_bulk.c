@@ -0,0 +1,411 @@
+/* get_num_bulk.c
+
+   Functions to parse many delimiter-separated numbers out of a buffer
+   (e.g. a file read into memory or mmap()ed), for numeric data rather
+   than command-line arguments.
+
+   Unlike getLong() and getInt(), these never print a diagnostic or
+   terminate the process; they return a GN_* status code, with the
+   number of values stored in '*count' and the offset of the offending
+   token (or, on success, the offset just past the last token parsed)
+   in '*consumed'.
+
+   Decimal integers are parsed on a fast path: the digit run is found
+   with SSE2 byte comparisons where available, and digits are converted
+   eight at a time with SWAR arithmetic on a 64-bit word. Other bases
+   (GN_ANY_BASE, GN_BASE_8, GN_BASE_16) use a simple digit loop that
+   accepts the same prefixes as strtol(3).
+   Decimal floats of up to 19 significant digits and modest exponents
+   are converted exactly on a fast path; anything else (hex floats,
+   "inf", very long mantissas) falls back to strtod(3).
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include "get_num.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define DEFAULT_DELIMS  " \t\r\n,"
+#define MAX_TOKEN       400     /* Longest token handed to strtod(3) */
+#define MAX_DIGITS      19      /* Any 19-digit decimal fits in uint64_t */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HAVE_SWAR 1
+#endif
+
+static const double pow10Exact[] = {    /* Powers of ten exact in a double */
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static void
+initDelims(unsigned char *isDelim, const char *delims)
+{
+    memset(isDelim, 0, 256);
+    if (delims == NULL)
+        delims = DEFAULT_DELIMS;
+    for (; *delims != '\0'; delims++)
+        isDelim[(unsigned char) *delims] = 1;
+}
+
+/* Return the number of leading ASCII digits in 's' */
+
+static size_t
+digitRun(const char *s, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+
+    while (len - i >= 16) {
+        __m128i x = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) (s + i)),
+                                 zero);
+        /* A byte is a digit iff (c - '0') is <= 9 when taken unsigned */
+        unsigned mask = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_min_epu8(x, nine), x));
+        if (mask != 0xFFFF)
+            return i + __builtin_ctz(~mask);
+        i += 16;
+    }
+#endif
+
+    while (i < len && (unsigned) (s[i] - '0') <= 9)
+        i++;
+    return i;
+}
+
+/* Convert exactly eight ASCII digits */
+
+static uint32_t
+parseEight(const char *s)
+{
+#ifdef HAVE_SWAR
+    uint64_t v;
+
+    memcpy(&v, s, 8);           /* s[0] ends up in the low byte */
+    v -= 0x3030303030303030ULL;
+    v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFULL;   /* Pairs */
+    v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFULL; /* Quads */
+    return (uint32_t) ((v * 10000 + (v >> 32)) & 0xFFFFFFFFULL);
+#else
+    uint32_t v = 0;
+    int j;
+
+    for (j = 0; j < 8; j++)
+        v = v * 10 + (s[j] - '0');
+    return v;
+#endif
+}
+
+/* Convert a run of at most MAX_DIGITS ASCII digits */
+
+static uint64_t
+parseDigits(const char *s, size_t n)
+{
+    uint64_t v = 0;
+
+    for (; n >= 8; n -= 8, s += 8)
+        v = v * 100000000 + parseEight(s);
+    for (; n > 0; n--, s++)
+        v = v * 10 + (*s - '0');
+    return v;
+}
+
+static size_t
+tokenEnd(const char *buf, size_t len, size_t p, const unsigned char *isDelim)
+{
+    while (p < len && !isDelim[(unsigned char) buf[p]])
+        p++;
+    return p;
+}
+
+/* Parse a decimal integer token at 'buf[*pos]' */
+
+static int
+longFast(const char *buf, size_t len, size_t *pos,
+        const unsigned char *isDelim, long *res)
+{
+    size_t p = *pos, run;
+    int neg = 0, sawZero = 0;
+    uint64_t v;
+
+    if (p < len && (buf[p] == '-' || buf[p] == '+'))
+        neg = buf[p++] == '-';
+    while (p < len && buf[p] == '0') {
+        sawZero = 1;
+        p++;
+    }
+
+    run = digitRun(buf + p, len - p);
+    if (run == 0 && !sawZero)
+        return GN_ERR_SYNTAX;
+    if (p + run < len && !isDelim[(unsigned char) buf[p + run]])
+        return GN_ERR_SYNTAX;
+    if (run > MAX_DIGITS)
+        return GN_ERR_RANGE;
+
+    v = parseDigits(buf + p, run);
+    if (v > (neg ? (uint64_t) LONG_MAX + 1 : (uint64_t) LONG_MAX))
+        return GN_ERR_RANGE;
+
+    *res = neg ? (long) (0 - v) : (long) v;
+    *pos = p + run;
+    return GN_OK;
+}
+
+/* Value of a digit in bases up to 16, or 99 */
+
+static int
+digitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return 99;
+}
+
+/* Parse an octal or hexadecimal integer token at 'buf[*pos]'. A 'base'
+   of 0 picks the base from the prefix as strtol(3) does. */
+
+static int
+longBase(const char *buf, size_t len, size_t *pos, int base,
+        const unsigned char *isDelim, long *res)
+{
+    size_t p = *pos, digits = 0;
+    int neg = 0, d;
+    uint64_t v = 0;
+
+    if (p < len && (buf[p] == '-' || buf[p] == '+'))
+        neg = buf[p++] == '-';
+
+    if ((base == 0 || base == 16) && len - p > 2 && buf[p] == '0' &&
+            (buf[p + 1] == 'x' || buf[p + 1] == 'X') &&
+            digitValue(buf[p + 2]) < 16) {
+        base = 16;
+        p += 2;
+    } else if (base == 0) {
+        if (p >= len || buf[p] != '0')
+            return longFast(buf, len, pos, isDelim, res);
+        base = 8;
+    }
+
+    for (; p < len && !isDelim[(unsigned char) buf[p]]; p++, digits++) {
+        d = digitValue(buf[p]);
+        if (d >= base)
+            return GN_ERR_SYNTAX;
+        if (v > (UINT64_MAX - d) / base)
+            return GN_ERR_RANGE;
+        v = v * base + d;
+    }
+    if (digits == 0)
+        return GN_ERR_SYNTAX;
+    if (v > (neg ? (uint64_t) LONG_MAX + 1 : (uint64_t) LONG_MAX))
+        return GN_ERR_RANGE;
+
+    *res = neg ? (long) (0 - v) : (long) v;
+    *pos = p;
+    return GN_OK;
+}
+
+/* Parse the token at 'buf[*pos]' with strtod(3) */
+
+static int
+doubleSlow(const char *buf, size_t len, size_t *pos,
+        const unsigned char *isDelim, double *res)
+{
+    char tok[MAX_TOKEN + 1], *endptr;
+    size_t end = tokenEnd(buf, len, *pos, isDelim);
+    size_t n = end - *pos;
+
+    if (n > MAX_TOKEN)
+        return GN_ERR_SYNTAX;
+    memcpy(tok, buf + *pos, n);
+    tok[n] = '\0';
+
+    errno = 0;
+    *res = strtod(tok, &endptr);
+    if (errno != 0)
+        return GN_ERR_RANGE;
+    if (endptr != tok + n || n == 0)
+        return GN_ERR_SYNTAX;
+
+    *pos = end;
+    return GN_OK;
+}
+
+/* Parse a decimal float token at 'buf[*pos]'. Mantissas that fit in
+   53 bits scaled by an exactly representable power of ten give a
+   correctly rounded result with a single multiply or divide; anything
+   else goes to doubleSlow(). */
+
+static int
+doubleFast(const char *buf, size_t len, size_t *pos,
+        const unsigned char *isDelim, double *res)
+{
+    size_t p = *pos, run, frac = 0;
+    int neg = 0, sawZero = 0, exp10 = 0, e = 0, eneg = 0;
+    uint64_t m;
+    const char *fracStart = NULL;
+
+    if (p < len && (buf[p] == '-' || buf[p] == '+'))
+        neg = buf[p++] == '-';
+    while (p < len && buf[p] == '0') {
+        sawZero = 1;
+        p++;
+    }
+
+    run = digitRun(buf + p, len - p);
+    if (run > MAX_DIGITS)
+        return doubleSlow(buf, len, pos, isDelim, res);
+    m = parseDigits(buf + p, run);
+    p += run;
+
+    if (p < len && buf[p] == '.') {
+        p++;
+        fracStart = buf + p;
+        frac = digitRun(fracStart, len - p);
+        if (run + frac > MAX_DIGITS)
+            return doubleSlow(buf, len, pos, isDelim, res);
+        m = m * (uint64_t) pow10Exact[frac] + parseDigits(fracStart, frac);
+        exp10 = -(int) frac;
+        p += frac;
+    }
+
+    if (run == 0 && frac == 0 && !sawZero)     /* "inf", "nan", "." ... */
+        return doubleSlow(buf, len, pos, isDelim, res);
+
+    if (p < len && (buf[p] == 'e' || buf[p] == 'E')) {
+        p++;
+        if (p < len && (buf[p] == '-' || buf[p] == '+'))
+            eneg = buf[p++] == '-';
+        run = digitRun(buf + p, len - p);
+        if (run == 0 || run > 4)
+            return doubleSlow(buf, len, pos, isDelim, res);
+        e = (int) parseDigits(buf + p, run);
+        exp10 += eneg ? -e : e;
+        p += run;
+    }
+
+    if (p < len && !isDelim[(unsigned char) buf[p]])
+        return doubleSlow(buf, len, pos, isDelim, res);
+    if (m > (1ULL << 53) || exp10 < -22 || exp10 > 22)
+        return doubleSlow(buf, len, pos, isDelim, res);
+
+    *res = exp10 < 0 ? (double) m / pow10Exact[-exp10] :
+                       (double) m * pow10Exact[exp10];
+    if (neg)
+        *res = -*res;
+    *pos = p;
+    return GN_OK;
+}
+
+static int
+checkSign(int flags, int negative, int zero)
+{
+    if ((flags & GN_NONNEG) && negative)
+        return GN_ERR_NEG;
+    if ((flags & GN_GT_0) && (negative || zero))
+        return GN_ERR_NOT_GT_0;
+    return GN_OK;
+}
+
+/* Parse up to 'max' integers from 'buf', separated by runs of any of
+   the characters in 'delims' (NULL means whitespace and commas). The
+   base is chosen by 'flags' as for getLong(). */
+
+int
+getLongs(const char *buf, size_t len, const char *delims, int flags,
+        long *out, size_t max, size_t *count, size_t *consumed)
+{
+    unsigned char isDelim[256];
+    size_t pos = 0, start, n = 0;
+    int base, status = GN_OK;
+    long v;
+
+    initDelims(isDelim, delims);
+    base = (flags & GN_ANY_BASE) ? 0 : (flags & GN_BASE_8) ? 8 :
+                        (flags & GN_BASE_16) ? 16 : 10;
+
+    while (n < max) {
+        while (pos < len && isDelim[(unsigned char) buf[pos]])
+            pos++;
+        if (pos == len)
+            break;
+
+        start = pos;
+        status = (base == 10) ? longFast(buf, len, &pos, isDelim, &v) :
+                                longBase(buf, len, &pos, base, isDelim, &v);
+        if (status == GN_OK)
+            status = checkSign(flags, v < 0, v == 0);
+        if (status != GN_OK) {
+            pos = start;
+            break;
+        }
+        out[n++] = v;
+    }
+
+    *count = n;
+    *consumed = pos;
+    return status;
+}
+
+/* Parse up to 'max' floating-point values from 'buf'. Only GN_NONNEG
+   and GN_GT_0 are meaningful in 'flags'. */
+
+int
+getDoubles(const char *buf, size_t len, const char *delims, int flags,
+        double *out, size_t max, size_t *count, size_t *consumed)
+{
+    unsigned char isDelim[256];
+    size_t pos = 0, start, n = 0;
+    int status = GN_OK;
+    double v;
+
+    initDelims(isDelim, delims);
+
+    while (n < max) {
+        while (pos < len && isDelim[(unsigned char) buf[pos]])
+            pos++;
+        if (pos == len)
+            break;
+
+        start = pos;
+        status = doubleFast(buf, len, &pos, isDelim, &v);
+        if (status == GN_OK)
+            status = checkSign(flags, v < 0, v == 0);
+        if (status != GN_OK) {
+            pos = start;
+            break;
+        }
+        out[n++] = v;
+    }
+
+    *count = n;
+    *consumed = pos;
+    return status;
+}
+
+/* Describe a status code returned by getLongs() or getDoubles() */
+
+const char *
+gnStrError(int status)
+{
+    switch (status) {
+    case GN_OK:             return "success";
+    case GN_ERR_SYNTAX:     return "nonnumeric characters";
+    case GN_ERR_RANGE:      return "value out of range";
+    case GN_ERR_NEG:        return "negative value not allowed";
+    case GN_ERR_NOT_GT_0:   return "value must be > 0";
+    default:                return "unknown status";
+    }
+}
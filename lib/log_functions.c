@@ -0,0 +1,253 @@
+/* log_functions.c
+
+   Asynchronous leveled logging for high-rate diagnostics.
+
+   Each thread formats its messages into its own single-producer,
+   single-consumer ring, so logWrite() takes no locks and makes no
+   system calls. A background thread drains all rings and writes the
+   records to stderr in large batches. When a ring is full the record
+   is dropped and counted (see logDropped()) rather than blocking the
+   caller.
+
+   logFlush() drains synchronously; it is called at exit and by the
+   terminating functions in error_functions.c, so queued messages are
+   not lost when a program dies.
+*/
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "log_functions.h"
+#include "tlpi_hdr.h"
+
+#define RING_SLOTS      1024            /* Must be a power of two */
+#define RECORD_SIZE     256             /* Longer messages are truncated */
+#define BATCH_SIZE      65536           /* Bytes per write() to stderr */
+#define IDLE_NSEC       2000000         /* Drainer sleep when rings are empty */
+
+struct logRecord {
+    enum Level level;
+    struct timespec when;
+    char text[RECORD_SIZE];
+};
+
+struct logRing {
+    _Atomic size_t head;                /* Next slot the producer fills */
+    _Atomic size_t tail;                /* Next slot the drainer reads */
+    atomic_bool inUse;                  /* Owned by a live thread */
+    struct logRing *next;               /* Registry link, never changes
+                                           once published */
+    struct logRecord slot[RING_SLOTS];
+};
+
+static _Atomic(struct logRing *) rings;     /* Lock-free registry */
+static atomic_ulong dropped;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ringKey;
+static pthread_mutex_t drainMutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct logRing *myRing;
+
+static const char *levelName[] = { "?", "LOW", "MEDIUM", "HIGH" };
+
+/* Write 'len' bytes to stderr, retrying on partial writes */
+
+static void
+writeAll(const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(STDERR_FILENO, buf, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return;             /* Nowhere left to report the error */
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+/* Move everything currently queued in all rings to stderr. Caller
+   must hold 'drainMutex', which makes us the single consumer.
+   Returns the number of records written. */
+
+static size_t
+drainRings(void)
+{
+    static char batch[BATCH_SIZE];
+    size_t used = 0, count = 0;
+    struct logRing *r;
+
+    for (r = atomic_load_explicit(&rings, memory_order_acquire);
+            r != NULL; r = r->next) {
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            struct logRecord *rec = &r->slot[tail & (RING_SLOTS - 1)];
+
+            if (used + RECORD_SIZE + 64 > BATCH_SIZE) {
+                writeAll(batch, used);
+                used = 0;
+            }
+            used += snprintf(batch + used, BATCH_SIZE - used,
+                    "%ld.%06ld %s: %s\n", (long) rec->when.tv_sec,
+                    rec->when.tv_nsec / 1000,
+                    levelName[rec->level >= LOW && rec->level <= HIGH ?
+                              rec->level : 0],
+                    rec->text);
+            count++;
+        }
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+    }
+
+    if (used > 0)
+        writeAll(batch, used);
+    return count;
+}
+
+static void *
+drainThread(void *arg)
+{
+    struct timespec idle = { 0, IDLE_NSEC };
+    size_t n;
+
+    (void) arg;
+    for (;;) {
+        pthread_mutex_lock(&drainMutex);
+        n = drainRings();
+        pthread_mutex_unlock(&drainMutex);
+
+        if (n == 0)
+            nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
+
+/* Called when a thread exits: its ring becomes available for reuse
+   once the drainer has emptied it */
+
+static void
+releaseRing(void *arg)
+{
+    struct logRing *r = arg;
+
+    atomic_store_explicit(&r->inUse, false, memory_order_release);
+}
+
+static void
+logInit(void)
+{
+    pthread_t t;
+    pthread_attr_t attr;
+
+    pthread_key_create(&ringKey, releaseRing);
+    atexit(logFlush);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&t, &attr, drainThread, NULL) != 0)
+        errMsg("logInit: pthread_create");  /* logFlush() still drains */
+    pthread_attr_destroy(&attr);
+}
+
+/* Return this thread's ring, claiming a released one or registering a
+   new one on first use */
+
+static struct logRing *
+getRing(void)
+{
+    struct logRing *r;
+    bool expected;
+
+    if (myRing != NULL)
+        return myRing;
+
+    pthread_once(&initOnce, logInit);
+
+    for (r = atomic_load_explicit(&rings, memory_order_acquire);
+            r != NULL; r = r->next) {
+        if (atomic_load(&r->head) != atomic_load(&r->tail))
+            continue;           /* Still holds a dead thread's records */
+        expected = false;
+        if (atomic_compare_exchange_strong(&r->inUse, &expected, true))
+            break;
+    }
+
+    if (r == NULL) {
+        r = calloc(1, sizeof(struct logRing));
+        if (r == NULL)
+            return NULL;
+        atomic_store(&r->inUse, true);
+        r->next = atomic_load(&rings);
+        while (!atomic_compare_exchange_weak(&rings, &r->next, r))
+            ;
+    }
+
+    pthread_setspecific(ringKey, r);
+    myRing = r;
+    return r;
+}
+
+/* Queue a message at 'level'. Use the logMsg() macro rather than
+   calling this directly, so that filtered levels cost nothing. */
+
+void
+logWrite(enum Level level, const char *format, ...)
+{
+    va_list argList;
+    struct logRing *r;
+    struct logRecord *rec;
+    size_t head;
+    int savedErrno;
+
+    savedErrno = errno;
+
+    r = getRing();
+    if (r == NULL) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        errno = savedErrno;
+        return;
+    }
+
+    head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&r->tail, memory_order_acquire)
+            >= RING_SLOTS) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        errno = savedErrno;
+        return;
+    }
+
+    rec = &r->slot[head & (RING_SLOTS - 1)];
+    rec->level = level;
+    clock_gettime(CLOCK_REALTIME, &rec->when);
+    va_start(argList, format);
+    vsnprintf(rec->text, RECORD_SIZE, format, argList);
+    va_end(argList);
+
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    errno = savedErrno;
+}
+
+/* Synchronously write out everything queued so far */
+
+void
+logFlush(void)
+{
+    int savedErrno;
+
+    savedErrno = errno;
+    pthread_mutex_lock(&drainMutex);
+    drainRings();
+    pthread_mutex_unlock(&drainMutex);
+    errno = savedErrno;
+}
+
+/* Number of messages discarded because a ring was full */
+
+unsigned long
+logDropped(void)
+{
+    return atomic_load(&dropped);
+}
@@ -0,0 +1,42 @@
+/* log_functions.h
+
+    Header file for log_functions.c.
+*/
+#ifndef LOG_FUNCTIONS_H
+#define LOG_FUNCTIONS_H
+
+/* Message levels, lowest to highest */
+
+enum Level {
+    LOW = 1,
+    MEDIUM,
+    HIGH
+};
+
+/* Messages below LOG_MIN_LEVEL are removed at compile time. Define it
+    (e.g. -DLOG_MIN_LEVEL=HIGH) before including this header to raise
+    the threshold. */
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOW
+#endif
+
+#define logMsg(level, ...) \
+     do { \
+         if ((level) >= LOG_MIN_LEVEL) \
+             logWrite((level), __VA_ARGS__); \
+     } while (0)
+
+#ifdef __GNUC__
+#define LOG_PRINTF __attribute__ ((__format__ (__printf__, 2, 3)))
+#else
+#define LOG_PRINTF
+#endif
+
+void logWrite(enum Level level, const char *format, ...) LOG_PRINTF ;
+
+void logFlush(void);
+
+unsigned long logDropped(void);
+
+#endif
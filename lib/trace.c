@@ -0,0 +1,145 @@
+/* trace.c
+
+   Per-thread trace rings and Chrome trace export for trace.h.
+
+   Recording an event is a store into the calling thread's own ring
+   (see traceEnd() in trace.h). This file only allocates rings on a
+   thread's first event and, off the hot path, converts what the rings
+   hold into the Chrome trace event JSON format, which both
+   chrome://tracing and https://ui.perfetto.dev load directly.
+
+   Timestamp counter ticks are converted to microseconds by comparing
+   the counter against CLOCK_MONOTONIC at the first event and again at
+   export time.
+*/
+#ifdef TLPI_TRACE
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "trace.h"
+#include "tlpi_hdr.h"
+
+#define MIN_CALIBRATION_NS 10000000     /* Counter vs. clock window */
+
+__thread struct traceRing *traceMyRing;
+
+static struct traceRing *rings;         /* Lock-free list of all rings */
+static pthread_once_t calibrateOnce = PTHREAD_ONCE_INIT;
+static uint64_t baseTicks;
+static double baseNs;
+
+static double
+monotonicNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+calibrateStart(void)
+{
+    baseNs = monotonicNs();
+    baseTicks = traceNow();
+}
+
+/* Allocate and register a ring for the calling thread */
+
+struct traceRing *
+traceRingCreate(void)
+{
+    struct traceRing *r;
+
+    pthread_once(&calibrateOnce, calibrateStart);
+
+    r = calloc(1, sizeof(struct traceRing));
+    if (r == NULL)
+        return NULL;
+    r->tid = syscall(SYS_gettid);
+
+    r->next = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&rings, &r->next, r, 1,
+                __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        ;
+
+    traceMyRing = r;
+    return r;
+}
+
+/* Write every event still held in the rings to 'path' as Chrome trace
+   JSON. Events recorded concurrently with the export may be missed or,
+   if a ring wraps during it, garbled, so call this once traced threads
+   are idle (e.g. at the end of main()). Returns 0, or -1 on error. */
+
+int
+traceWrite(const char *path)
+{
+    struct traceRing *r;
+    struct traceEvent *e;
+    struct timespec pause;
+    uint64_t head, first, j, ticks, origin;
+    double ns, ticksPerUs;
+    int pid, firstEvent = 1;
+    FILE *fp;
+
+    if (__atomic_load_n(&rings, __ATOMIC_ACQUIRE) == NULL)
+        pthread_once(&calibrateOnce, calibrateStart);
+
+    /* Make sure the calibration window isn't too short to be accurate */
+
+    ns = monotonicNs() - baseNs;
+    if (ns < MIN_CALIBRATION_NS) {
+        pause.tv_sec = 0;
+        pause.tv_nsec = MIN_CALIBRATION_NS - ns;
+        nanosleep(&pause, NULL);
+    }
+    ticks = traceNow() - baseTicks;
+    ns = monotonicNs() - baseNs;
+    ticksPerUs = ticks / ns * 1000;
+
+    fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+
+    /* Timestamps count from the earliest event still held. The
+       calibration point can't serve: it is taken when the first event
+       ends, after that event started. */
+
+    origin = baseTicks;
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL;
+            r = r->next) {
+        head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        first = head > TRACE_RING_SLOTS ? head - TRACE_RING_SLOTS : 0;
+        for (j = first; j < head; j++)
+            if (r->slot[j & (TRACE_RING_SLOTS - 1)].start < origin)
+                origin = r->slot[j & (TRACE_RING_SLOTS - 1)].start;
+    }
+
+    pid = getpid();
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL;
+            r = r->next) {
+        head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        first = head > TRACE_RING_SLOTS ? head - TRACE_RING_SLOTS : 0;
+
+        for (j = first; j < head; j++) {
+            e = &r->slot[j & (TRACE_RING_SLOTS - 1)];
+            fprintf(fp, "%s\n{\"name\": \"%s\", \"ph\": \"X\", "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d}",
+                    firstEvent ? "" : ",", e->name,
+                    (e->start - origin) / ticksPerUs,
+                    (e->end - e->start) / ticksPerUs, pid, r->tid);
+            firstEvent = 0;
+        }
+    }
+
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) == EOF)
+        return -1;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/* trace.h
+
+   Header file for trace.c.
+
+   Scoped trace points for finding where time goes in a hot path:
+
+       {
+           TRACE_SCOPE("VIDIOC_DQBUF");
+           ...
+       }
+
+   records the time spent in the enclosing block. Names must be string
+   literals (or otherwise outlive the program's tracing). Tracing is
+   compiled in only if TLPI_TRACE is defined; otherwise TRACE_SCOPE()
+   expands to nothing and traceWrite() does nothing, so trace.c need
+   not be linked.
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef TLPI_TRACE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define TRACE_RING_SLOTS 65536          /* Per thread; oldest overwritten */
+
+struct traceEvent {
+    const char *name;
+    uint64_t start;                     /* Timestamp counter ticks */
+    uint64_t end;
+};
+
+struct traceRing {
+    uint64_t head;                      /* Events ever recorded */
+    int tid;
+    struct traceRing *next;
+    struct traceEvent slot[TRACE_RING_SLOTS];
+};
+
+struct traceScope {
+    const char *name;
+    uint64_t start;
+};
+
+extern __thread struct traceRing *traceMyRing;
+
+struct traceRing *traceRingCreate(void);
+
+static inline uint64_t
+traceNow(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (t));
+    return t;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static inline struct traceScope
+traceBegin(const char *name)
+{
+    struct traceScope s = { name, traceNow() };
+
+    return s;
+}
+
+/* Called by the cleanup attribute when a TRACE_SCOPE() goes out of
+   scope: a thread-local store and nothing more, unless this is the
+   thread's first event */
+
+static inline void
+traceEnd(struct traceScope *s)
+{
+    uint64_t end = traceNow();
+    struct traceRing *r = traceMyRing;
+    struct traceEvent *e;
+
+    if (r == NULL && (r = traceRingCreate()) == NULL)
+        return;
+
+    e = &r->slot[r->head & (TRACE_RING_SLOTS - 1)];
+    e->name = s->name;
+    e->start = s->start;
+    e->end = end;
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+#define TRACE_CAT2(a, b) a ## b
+#define TRACE_CAT(a, b) TRACE_CAT2(a, b)
+
+#define TRACE_SCOPE(name) \
+    struct traceScope TRACE_CAT(traceScope_, __LINE__) \
+        __attribute__ ((__cleanup__ (traceEnd))) = traceBegin(name)
+
+int traceWrite(const char *path);
+
+#else
+
+#define TRACE_SCOPE(name) ((void) 0)
+
+static inline int
+traceWrite(const char *path)
+{
+    (void) path;
+    return 0;
+}
+
+#endif
+
+#endif
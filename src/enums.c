@@ -1,10 +1,6 @@
-enum Level {
-   LOW = 1,
-   MEDIUM,
-   HIGH
-};
+#include "../lib/log_functions.h"
 
 int main() {
    enum Level myLevel = HIGH;
    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,13 @@
+#include "frame.h"
+
+//Fraction of pixels in a packed YUYV frame whose luma is below BLACK_LEVEL.
+//Every pixel has its own Y sample at an even byte offset.
+double frame_black_ratio(const unsigned char *yuyv, size_t width, size_t height) {
+   size_t total_pixels = width * height;
+   size_t black_pixels = 0;
+
+   for (size_t i = 0; i < total_pixels * 2; i += 2)
+      black_pixels += yuyv[i] < BLACK_LEVEL;
+
+   return total_pixels ? (double)black_pixels / total_pixels : 0;
+}
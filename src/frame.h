@@ -0,0 +1,10 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+
+#define BLACK_LEVEL  16    //Luma below this counts as black (video range starts at 16)
+
+double frame_black_ratio(const unsigned char *yuyv, size_t width, size_t height);
+
+#endif
@@ -1,3 +1,4 @@
+//Build: cc -O2 -pthread g_photo.c snapshot.c (add -DTLPI_TRACE ../lib/trace.c for -t)
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,12 +8,24 @@
 #include <sys/ioctl.h>
 #include <linux/videodev2.h>
 #include <sys/mman.h>
+#include <poll.h>
 #include <getopt.h>
+#include "snapshot.h"
+#include "../lib/trace.h"
 
 #define WIDTH     640
 #define HEIGHT    480
 
+#define DAEMON_BUFFERS  4     //Queued while the daemon streams
+#define FRAME_WAIT_MS   200   //Longest the daemon waits on the camera before checking for shutdown
+#define TEST_FPS        30
+
 int list_controls_requested = 0;
+const char *trace_path = NULL;
+const char *daemon_socket = NULL;
+const char *snapshot_socket = NULL;
+const char *out_path = "frame.raw";
+int test_source_requested = 0;
 
 struct buffer {
    void *start;
@@ -58,13 +71,36 @@ const struct v4l2_capability_info cap_info[] = {
 };
 
 void usage(char *program_name) {
-   printf("Usage: %s [-lc]\n", program_name);
+   printf("Usage: %s [-lc] [-t trace.json] [-d socket [-S]] [-s socket] [-o file]\n", program_name);
    printf("Options:\n");
    printf("\t-lc\tList available controls\n");
+   printf("\t-t\tWrite a Chrome trace of each stage (build with -DTLPI_TRACE)\n");
+   printf("\t-d\tRun as a snapshot daemon listening on this Unix socket\n");
+   printf("\t-S\tWith -d, serve a synthetic test pattern instead of the camera\n");
+   printf("\t-s\tRequest a snapshot from the daemon on this Unix socket\n");
+   printf("\t-o\tFile to save the frame to (default: frame.raw)\n");
    exit(EXIT_FAILURE);
 }
 
+//Trace point names must be string literals, so map the ones we use
+const char *ioctl_name(int request) {
+   switch (request) {
+      case VIDIOC_QUERYCAP:   return "VIDIOC_QUERYCAP";
+      case VIDIOC_QUERYCTRL:  return "VIDIOC_QUERYCTRL";
+      case VIDIOC_G_CTRL:     return "VIDIOC_G_CTRL";
+      case VIDIOC_S_FMT:      return "VIDIOC_S_FMT";
+      case VIDIOC_REQBUFS:    return "VIDIOC_REQBUFS";
+      case VIDIOC_QUERYBUF:   return "VIDIOC_QUERYBUF";
+      case VIDIOC_QBUF:       return "VIDIOC_QBUF";
+      case VIDIOC_DQBUF:      return "VIDIOC_DQBUF";
+      case VIDIOC_STREAMON:   return "VIDIOC_STREAMON";
+      case VIDIOC_STREAMOFF:  return "VIDIOC_STREAMOFF";
+      default:                return "ioctl";
+   }
+}
+
 int xioctl(int fd, int request, void *arg) {
+   TRACE_SCOPE(ioctl_name(request));
    int r;
 
    //Need to do{} first before checking for -1 and EINTR
@@ -88,7 +124,7 @@ void print_control_value(int fd, __u32 controlId) {
    memset(&control, 0, sizeof(control));
    control.id = controlId;
 
-   if (ioctl(fd, VIDIOC_G_CTRL, &control) == -1) {
+   if (xioctl(fd, VIDIOC_G_CTRL, &control) == -1) {
       perror("VIDIOC_G_CTRL");
       return;
    }
@@ -104,7 +140,7 @@ void list_controls(int fd) {
    printf("Supported controls:\n");
 
    do {
-      if (ioctl(fd, VIDIOC_QUERYCTRL, &queryctrl) == -1) {
+      if (xioctl(fd, VIDIOC_QUERYCTRL, &queryctrl) == -1) {
          return; //eventually we run out of next ctrls, just return and ignore errno
       }
       printf("\t%s\n", queryctrl.name);
@@ -117,23 +153,207 @@ void list_controls(int fd) {
    } while (queryctrl.id != V4L2_CTRL_FLAG_NEXT_CTRL);
 }
 
+//Camera as a frame_source for the snapshot daemon: the same setup as a
+//one-shot capture, but with several buffers kept queued while streaming
+struct v4l2_source {
+   int fd;
+   unsigned int count;
+   struct buffer buffers[DAEMON_BUFFERS];
+   struct v4l2_buffer current;
+};
+
+int v4l2_source_next(struct frame_source *src, const void **data, size_t *len) {
+   struct v4l2_source *vs = src->ctx;
+   struct pollfd pfd = {vs->fd, POLLIN, 0};
+
+   //Wait in poll() rather than DQBUF, so a stalled camera can't keep the
+   //daemon from shutting down
+   int r = poll(&pfd, 1, FRAME_WAIT_MS);
+   if (r == 0 || (r == -1 && errno == EINTR))
+      return 1;
+   if (r == -1)
+      return -1;
+
+   memset(&vs->current, 0, sizeof(vs->current));
+   vs->current.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   vs->current.memory = V4L2_MEMORY_MMAP;
+   if (xioctl(vs->fd, VIDIOC_DQBUF, &vs->current) == -1)
+      return -1;
+
+   *data = vs->buffers[vs->current.index].start;
+   *len = vs->current.bytesused;
+   return 0;
+}
+
+int v4l2_source_release(struct frame_source *src) {
+   struct v4l2_source *vs = src->ctx;
+   return xioctl(vs->fd, VIDIOC_QBUF, &vs->current);
+}
+
+void v4l2_source_stop(struct frame_source *src) {
+   struct v4l2_source *vs = src->ctx;
+   int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+   xioctl(vs->fd, VIDIOC_STREAMOFF, &type);
+   for (unsigned int i = 0; i < vs->count; ++i)
+      munmap(vs->buffers[i].start, vs->buffers[i].length);
+   close(vs->fd);
+   free(vs);
+}
+
+int v4l2_source_init(struct frame_source *src, const char *dev_name) {
+   struct v4l2_source *vs = calloc(1, sizeof(*vs));
+   if (vs == NULL)
+      return -1;
+   src->ctx = vs;
+
+   vs->fd = open(dev_name, O_RDWR);
+   if (vs->fd == -1) {
+      perror("Error opening video device");
+      free(vs);
+      return -1;
+   }
+
+   struct v4l2_format fmt;
+   memset(&fmt, 0, sizeof(fmt));
+   fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   fmt.fmt.pix.width = WIDTH;
+   fmt.fmt.pix.height = HEIGHT;
+   fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+   fmt.fmt.pix.field = V4L2_FIELD_INTERLACED;
+   if (xioctl(vs->fd, VIDIOC_S_FMT, &fmt) == -1) {
+      perror("Error setting pixel format");
+      goto fail;
+   }
+
+   struct v4l2_requestbuffers request;
+   memset(&request, 0, sizeof(request));
+   request.count = DAEMON_BUFFERS;
+   request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   request.memory = V4L2_MEMORY_MMAP;
+   if (xioctl(vs->fd, VIDIOC_REQBUFS, &request) == -1 || request.count == 0) {
+      perror("Error requesting buffers");
+      goto fail;
+   }
+
+   //The driver may grant fewer (or more) buffers than asked for
+   for (vs->count = 0; vs->count < request.count && vs->count < DAEMON_BUFFERS; ++vs->count) {
+      struct v4l2_buffer buf;
+      memset(&buf, 0, sizeof(buf));
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      buf.index = vs->count;
+      if (xioctl(vs->fd, VIDIOC_QUERYBUF, &buf) == -1) {
+         perror("Error querying buffer");
+         goto fail;
+      }
+      vs->buffers[vs->count].length = buf.length;
+      vs->buffers[vs->count].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, vs->fd, buf.m.offset);
+      if (vs->buffers[vs->count].start == MAP_FAILED) {
+         perror("Error memory mapping buffer");
+         goto fail;
+      }
+      if (xioctl(vs->fd, VIDIOC_QBUF, &buf) == -1) {
+         munmap(vs->buffers[vs->count].start, buf.length);
+         perror("Error queuing buffer");
+         goto fail;
+      }
+   }
+
+   int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   if (xioctl(vs->fd, VIDIOC_STREAMON, &type) == -1) {
+      perror("Error starting capture");
+      goto fail;
+   }
+
+   src->width = fmt.fmt.pix.width;
+   src->height = fmt.fmt.pix.height;
+   src->pixelformat = fmt.fmt.pix.pixelformat;
+   src->next = v4l2_source_next;
+   src->release = v4l2_source_release;
+   src->stop = v4l2_source_stop;
+   return 0;
+
+fail:
+   for (unsigned int i = 0; i < vs->count; ++i)
+      munmap(vs->buffers[i].start, vs->buffers[i].length);
+   close(vs->fd);
+   free(vs);
+   return -1;
+}
+
+int run_daemon(const char *dev_name) {
+   struct frame_source src;
+
+   if (test_source_requested) {
+      if (test_source_init(&src, WIDTH, HEIGHT, TEST_FPS) == -1) {
+         perror("Error creating test source");
+         return 1;
+      }
+   } else if (v4l2_source_init(&src, dev_name) == -1) {
+      return 1;
+   }
+
+   int r = snapshot_serve(daemon_socket, &src);
+   src.stop(&src);
+   return r == -1;
+}
+
+void write_trace(void) {
+   if (traceWrite(trace_path) == -1)
+      perror("Error writing trace");
+}
+
 int main(int argc, char *argv[]) {
    //Parse cli args
    int opt;
-   while ((opt = getopt(argc, argv, "lc")) != -1) {
+   while ((opt = getopt(argc, argv, "lct:d:Ss:o:")) != -1) {
       switch (opt) {
          case 'l':
          case 'c':
             list_controls_requested = 1;
             break;
+         case 't':
+            trace_path = optarg;
+#ifndef TLPI_TRACE
+            fprintf(stderr, "Warning: built without -DTLPI_TRACE, no trace will be written\n");
+#endif
+            break;
+         case 'd':
+            daemon_socket = optarg;
+            break;
+         case 'S':
+            test_source_requested = 1;
+            break;
+         case 's':
+            snapshot_socket = optarg;
+            break;
+         case 'o':
+            out_path = optarg;
+            break;
          default:
             usage(argv[0]);
       }
    }
 
-   //Open device 'file'
+   //Write the trace however we exit, failed runs being the interesting ones
+   if (trace_path != NULL)
+      atexit(write_trace);
+
    const char *dev_name = "/dev/video0";
-   int fd = open(dev_name, O_RDWR);
+
+   //Snapshot client/daemon modes skip the one-shot capture entirely
+   if (snapshot_socket != NULL)
+      return snapshot_request(snapshot_socket, out_path) == -1;
+   if (daemon_socket != NULL)
+      return run_daemon(dev_name);
+
+   //Open device 'file'
+   int fd;
+   {
+      TRACE_SCOPE("open");
+      fd = open(dev_name, O_RDWR);
+   }
    if (fd == -1) {
       perror("Error opening video device");
       return 1;
@@ -243,7 +463,10 @@ int main(int argc, char *argv[]) {
    printf("Buffer offset: %lld\n", (long long)buf.m.offset);
 
    //Memory map the buffer
-   buffer.start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+   {
+      TRACE_SCOPE("mmap");
+      buffer.start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+   }
    if (buffer.start == MAP_FAILED) {
       perror("Error memory mapping buffer");
       close(fd);
@@ -317,17 +540,20 @@ int main(int argc, char *argv[]) {
    */
 
    //Save raw frame for MJPG conversion later
-   FILE *out_fp = fopen("frame.raw", "wb");
+   FILE *out_fp = fopen(out_path, "wb");
    if (out_fp == NULL) {
       perror("Error opening output file");
       munmap(buffer.start, buffer.length);
       close(fd);
       return 1;
    }
-   fwrite(buffer.start, 1, buf.bytesused, out_fp);
+   {
+      TRACE_SCOPE("write frame");
+      fwrite(buffer.start, 1, buf.bytesused, out_fp);
+      fclose(out_fp);
+   }
 
    //Cleanup memory & files
-   fclose(out_fp);
    munmap(buffer.start, buffer.length);
    close(fd);
 
@@ -1,23 +1,132 @@
+//Build: cc -O2 -pthread io.c squeeze.c
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "squeeze.h"
+#include "../lib/bench.h"
 
-int main() {
-   int character;
-   int prev_char_is_space = 0;
+void usage(char *program_name) {
+   fprintf(stderr, "Usage: %s [-j threads] [-v] [-s] [file]\n", program_name);
+   fprintf(stderr, "Options:\n");
+   fprintf(stderr, "\t-j\tSqueeze file with this many threads (default: online CPUs)\n");
+   fprintf(stderr, "\t-v\tReport elapsed time and throughput on stderr\n");
+   fprintf(stderr, "\t-s\tRun 1..N threads to /dev/null and report scaling\n");
+   exit(EXIT_FAILURE);
+}
 
-   printf("Enter a sentence with multiple spaces (Press CTRL+D to exit):\n");
+void report_scaling(int fd, int max_threads) {
+   int null_fd = open("/dev/null", O_WRONLY);
+   double base = 0;
 
-   while ((character = getchar()) != EOF) {
-      if (character == ' ' || character == '\t') {
-         if (!prev_char_is_space) {
+   if (null_fd == -1) {
+      perror("Error opening /dev/null");
+      return;
+   }
+
+   //Doubling steps, always ending on the count that was asked for
+   fprintf(stderr, "threads\tseconds\tspeedup\n");
+   for (int n = 1;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+      lseek(fd, 0, SEEK_SET);
+      double t = benchNow();
+      if (squeeze_file(fd, null_fd, n) == -1) {
+         perror("Error squeezing file");
+         break;
+      }
+      t = benchNow() - t;
+      if (n == 1)
+         base = t;
+      fprintf(stderr, "%d\t%.3f\t%.2fx\n", n, t, base / t);
+      if (n == max_threads)
+         break;
+   }
+   close(null_fd);
+}
+
+int main(int argc, char *argv[]) {
+   int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+   int verbose = 0, scaling = 0;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "j:vs")) != -1) {
+      switch (opt) {
+         case 'j': {
+            char *end;
+            long n = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || n < 1)
+               usage(argv[0]);
+            nthreads = n > MAX_THREADS ? MAX_THREADS : n;
+            break;
+         }
+         case 'v':
+            verbose = 1;
+            break;
+         case 's':
+            scaling = 1;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (nthreads < 1)
+      nthreads = 1;
+   if (nthreads > MAX_THREADS)
+      nthreads = MAX_THREADS;
+
+   //No file: the original interactive squeeze of stdin
+   if (optind >= argc) {
+      int character;
+      int prev_char_is_space = 0;
+
+      printf("Enter a sentence with multiple spaces (Press CTRL+D to exit):\n");
+
+      while ((character = getchar()) != EOF) {
+         if (character == ' ' || character == '\t') {
+            if (!prev_char_is_space) {
+               putchar(character);
+               prev_char_is_space = 1;
+            }
+         } else {
             putchar(character);
-            prev_char_is_space = 1;
+            prev_char_is_space = 0;
          }
-      } else {
-         putchar(character);
-         prev_char_is_space = 0;
       }
+
+      printf("\n");
+      return 0;
+   }
+
+   int fd = open(argv[optind], O_RDONLY);
+   if (fd == -1) {
+      perror("Error opening input file");
+      return 1;
+   }
+
+   if (scaling) {
+      report_scaling(fd, nthreads);
+      close(fd);
+      return 0;
+   }
+
+   double t = benchNow();
+   if (squeeze_file(fd, STDOUT_FILENO, nthreads) == -1) {
+      perror("Error squeezing file");
+      close(fd);
+      return 1;
+   }
+   t = benchNow() - t;
+
+   if (verbose) {
+      off_t size = lseek(fd, 0, SEEK_END);
+      fprintf(stderr, "threads=%d bytes=%lld elapsed=%.3fs throughput=%.1f MB/s\n",
+            nthreads, (long long)size, t, size / t / 1e6);
    }
 
-   printf("\n");
+   close(fd);
    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,173 @@
+//Build: cc -O2 num_parse.c ../lib/get_num_bulk.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../lib/get_num.h"
+#include "../lib/bench.h"
+
+#define BATCH     4096
+#define TOKEN_MAX 400     //Longest final token the strtol() baseline copies out
+
+void usage(char *program_name) {
+   printf("Usage: %s [-f] [-x] [-b] file\n", program_name);
+   printf("Options:\n");
+   printf("\t-f\tParse floating-point values (default: integers)\n");
+   printf("\t-x\tIntegers are hexadecimal\n");
+   printf("\t-b\tBenchmark against repeated strtol()/strtod()\n");
+   exit(EXIT_FAILURE);
+}
+
+static int is_delim(char c) {
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',';
+}
+
+//Sum every value in the buffer with the bulk parser; returns values parsed or -1
+long bulk_sum(const char *buf, size_t len, int floats, int flags, double *sum) {
+   long lvals[BATCH];
+   double dvals[BATCH];
+   size_t pos = 0, count, consumed;
+   long total = 0;
+   int status;
+
+   *sum = 0;
+   do {
+      if (floats) {
+         status = getDoubles(buf + pos, len - pos, NULL, flags, dvals, BATCH, &count, &consumed);
+         for (size_t i = 0; i < count; ++i)
+            *sum += dvals[i];
+      } else {
+         status = getLongs(buf + pos, len - pos, NULL, flags, lvals, BATCH, &count, &consumed);
+         for (size_t i = 0; i < count; ++i)
+            *sum += lvals[i];
+      }
+      pos += consumed;
+      total += count;
+      if (status != GN_OK) {
+         fprintf(stderr, "Parse error at byte %zu: %s\n", pos, gnStrError(status));
+         return -1;
+      }
+   } while (count == BATCH);
+
+   return total;
+}
+
+//Baseline: one strtol()/strtod() call per value, the way getNum() works.
+//Values are parsed in place; only a last token with no delimiter after it
+//could lead strtol() off the end of the mapping, so that one is copied out.
+long strtol_sum(const char *buf, size_t len, int floats, int base, double *sum) {
+   const char *p = buf, *end = buf + len, *tail = end;
+   char tok[TOKEN_MAX + 1], *endptr;
+   long total = 0;
+
+   while (tail > buf && !is_delim(tail[-1]))
+      --tail;
+
+   *sum = 0;
+   while (p < end) {
+      while (p < end && is_delim(*p))
+         ++p;
+      if (p == end)
+         break;
+
+      const char *s = p;
+      if (p >= tail) {
+         size_t n = end - p;
+         if (n > TOKEN_MAX) {
+            fprintf(stderr, "Token too long at byte %td\n", p - buf);
+            return -1;
+         }
+         memcpy(tok, p, n);
+         tok[n] = '\0';
+         s = tok;
+      }
+
+      errno = 0;
+      if (floats)
+         *sum += strtod(s, &endptr);
+      else
+         *sum += strtol(s, &endptr, base);
+      if (errno != 0 || endptr == s) {
+         fprintf(stderr, "strtol/strtod failed at byte %td\n", p - buf);
+         return -1;
+      }
+      p += endptr - s;
+      ++total;
+   }
+
+   return total;
+}
+
+int main(int argc, char *argv[]) {
+   int floats = 0, bench = 0, flags = 0;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "fxb")) != -1) {
+      switch (opt) {
+         case 'f':
+            floats = 1;
+            break;
+         case 'x':
+            flags |= GN_BASE_16;
+            break;
+         case 'b':
+            bench = 1;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (optind >= argc)
+      usage(argv[0]);
+
+   int fd = open(argv[optind], O_RDONLY);
+   if (fd == -1) {
+      perror("Error opening input file");
+      return 1;
+   }
+   struct stat sb;
+   if (fstat(fd, &sb) == -1) {
+      perror("Error getting file size");
+      close(fd);
+      return 1;
+   }
+   if (sb.st_size == 0) {
+      printf("Values: 0\tSum: 0\n");
+      close(fd);
+      return 0;
+   }
+   char *buf = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (buf == MAP_FAILED) {
+      perror("Error mapping input file");
+      return 1;
+   }
+
+   double sum, t = benchNow();
+   long n = bulk_sum(buf, sb.st_size, floats, flags, &sum);
+   t = benchNow() - t;
+   if (n == -1) {
+      munmap(buf, sb.st_size);
+      return 1;
+   }
+   printf("Values: %ld\tSum: %.17g\n", n, sum);
+
+   if (bench) {
+      double base_sum, base_t = benchNow();
+      long base_n = strtol_sum(buf, sb.st_size, floats, (flags & GN_BASE_16) ? 16 : 10, &base_sum);
+      base_t = benchNow() - base_t;
+      printf("bulk:\t%.1f M values/s, %.0f MB/s\n", n / t / 1e6, sb.st_size / t / 1e6);
+      printf("%s:\t%.1f M values/s, %.0f MB/s%s\n", floats ? "strtod" : "strtol",
+            base_n / base_t / 1e6, sb.st_size / base_t / 1e6,
+            (base_n == n && base_sum == sum) ? "" : " (RESULTS DIFFER)");
+   }
+
+   munmap(buf, sb.st_size);
+   return 0;
+}
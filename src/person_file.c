@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "person_file.h"
+
+#define ALIGN8(n)    (((n) + 7) & ~(uint64_t)7)
+
+//A section must lie inside the file and be aligned for its element type
+static int section_ok(uint64_t off, uint64_t len, size_t file_len) {
+   return off % 8 == 0 && off <= file_len && len <= file_len - off;
+}
+
+int person_file_open(const char *path, struct person_file *pf) {
+   struct person_file_header h;
+   struct stat sb;
+
+   memset(pf, 0, sizeof(*pf));
+
+   int fd = open(path, O_RDONLY);
+   if (fd == -1)
+      return -1;
+   if (fstat(fd, &sb) == -1) {
+      close(fd);
+      return -1;
+   }
+   if ((size_t)sb.st_size < sizeof(h)) {
+      close(fd);
+      errno = EINVAL;
+      return -1;
+   }
+
+   void *map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return -1;
+
+   memcpy(&h, map, sizeof(h));
+   uint64_t count = le64toh(h.count);
+   uint64_t strings_len = le64toh(h.strings_len);
+   size_t len = sb.st_size;
+
+   if (memcmp(h.magic, PERSON_FILE_MAGIC, sizeof(h.magic)) != 0
+         || le32toh(h.version) != PERSON_FILE_VERSION
+         || le32toh(h.header_size) != sizeof(h)
+         || count > len
+         || !section_ok(le64toh(h.age_off), count * sizeof(int32_t), len)
+         || !section_ok(le64toh(h.gender_off), count, len)
+         || !section_ok(le64toh(h.first_name_off), count * sizeof(uint32_t), len)
+         || !section_ok(le64toh(h.last_name_off), count * sizeof(uint32_t), len)
+         || !section_ok(le64toh(h.strings_off), strings_len, len)
+         || strings_len == 0) {
+      munmap(map, sb.st_size);
+      errno = EINVAL;
+      return -1;
+   }
+
+   const char *base = map;
+   pf->strings = base + le64toh(h.strings_off);
+   pf->strings_len = strings_len;
+   //A trailing NUL means every in-range offset yields a terminated string
+   if (pf->strings[strings_len - 1] != '\0') {
+      munmap(map, sb.st_size);
+      errno = EINVAL;
+      return -1;
+   }
+
+   pf->map = map;
+   pf->map_len = len;
+   pf->count = count;
+   pf->age = (const int32_t *)(base + le64toh(h.age_off));
+   pf->gender = (const uint8_t *)(base + le64toh(h.gender_off));
+   pf->first_name = (const uint32_t *)(base + le64toh(h.first_name_off));
+   pf->last_name = (const uint32_t *)(base + le64toh(h.last_name_off));
+   return 0;
+}
+
+void person_file_close(struct person_file *pf) {
+   if (pf->map != NULL)
+      munmap(pf->map, pf->map_len);
+   memset(pf, 0, sizeof(*pf));
+}
+
+static void writer_discard(struct person_writer *pw) {
+   FILE **files[] = {&pw->out, &pw->age, &pw->gender, &pw->first_name, &pw->last_name, &pw->strings};
+   for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+      if (*files[i] != NULL)
+         fclose(*files[i]);
+      *files[i] = NULL;
+   }
+   free(pw->cache);
+   pw->cache = NULL;
+   free(pw->path);
+   pw->path = NULL;
+   free(pw->tmp_path);
+   pw->tmp_path = NULL;
+}
+
+int person_writer_open(const char *path, struct person_writer *pw) {
+   memset(pw, 0, sizeof(*pw));
+
+   pw->path = strdup(path);
+   pw->tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+   if (pw->path == NULL || pw->tmp_path == NULL) {
+      writer_discard(pw);
+      errno = ENOMEM;
+      return -1;
+   }
+   sprintf(pw->tmp_path, "%s.tmp", path);
+
+   pw->out = fopen(pw->tmp_path, "wb");
+   pw->age = tmpfile();
+   pw->gender = tmpfile();
+   pw->first_name = tmpfile();
+   pw->last_name = tmpfile();
+   pw->strings = tmpfile();
+   pw->cache = calloc(PERSON_WRITER_CACHE, sizeof(*pw->cache));
+   if (!pw->out || !pw->age || !pw->gender || !pw->first_name || !pw->last_name
+         || !pw->strings || !pw->cache) {
+      person_writer_abort(pw);
+      return -1;
+   }
+
+   //Offset 0 is the empty name, so the table is never empty
+   if (fputc('\0', pw->strings) == EOF) {
+      person_writer_abort(pw);
+      return -1;
+   }
+   pw->strings_len = 1;
+   return 0;
+}
+
+static uint32_t hash_name(const char *s) {
+   uint32_t h = 2166136261u;
+   while (*s) {
+      h ^= (unsigned char)*s++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+//Append a name to the string table, reusing it if it was written recently
+static int write_name(struct person_writer *pw, const char *name, uint32_t *ref) {
+   size_t len = strlen(name);
+   struct person_writer_cache *c = NULL;
+
+   if (len == 0) {
+      *ref = 0;
+      return 0;
+   }
+   if (len < PERSON_WRITER_NAME) {
+      c = &pw->cache[hash_name(name) % PERSON_WRITER_CACHE];
+      if (c->ref != 0 && strcmp(c->name, name) == 0) {
+         *ref = c->ref;
+         return 0;
+      }
+   }
+
+   if (pw->strings_len + len + 1 > UINT32_MAX) {
+      errno = EOVERFLOW;
+      return -1;
+   }
+   if (fwrite(name, 1, len + 1, pw->strings) != len + 1)
+      return -1;
+   *ref = pw->strings_len;
+   pw->strings_len += len + 1;
+
+   if (c != NULL) {
+      memcpy(c->name, name, len + 1);
+      c->ref = *ref;
+   }
+   return 0;
+}
+
+int person_writer_add(struct person_writer *pw, const struct person *p) {
+   uint32_t first, last;
+
+   if (write_name(pw, p->first_name, &first) == -1 || write_name(pw, p->last_name, &last) == -1)
+      return -1;
+
+   uint32_t age = htole32((uint32_t)p->age);
+   uint8_t gender = p->gender;
+   first = htole32(first);
+   last = htole32(last);
+   if (fwrite(&age, sizeof(age), 1, pw->age) != 1
+         || fwrite(&gender, sizeof(gender), 1, pw->gender) != 1
+         || fwrite(&first, sizeof(first), 1, pw->first_name) != 1
+         || fwrite(&last, sizeof(last), 1, pw->last_name) != 1)
+      return -1;
+
+   ++pw->count;
+   return 0;
+}
+
+//Copy a spooled column into the output and pad it to the next section
+static int append_section(FILE *out, FILE *in, uint64_t *pos) {
+   char buf[BUFSIZ];
+   static const char zeros[8];
+   size_t n;
+
+   if (fflush(in) == EOF || fseek(in, 0, SEEK_SET) == -1)
+      return -1;
+   while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+      if (fwrite(buf, 1, n, out) != n)
+         return -1;
+      *pos += n;
+   }
+   if (ferror(in))
+      return -1;
+
+   size_t pad = ALIGN8(*pos) - *pos;
+   if (fwrite(zeros, 1, pad, out) != pad)
+      return -1;
+   *pos += pad;
+   return 0;
+}
+
+int person_writer_close(struct person_writer *pw) {
+   struct person_file_header h;
+   uint64_t pos = sizeof(h);
+   uint64_t n = pw->count;
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, PERSON_FILE_MAGIC, sizeof(h.magic));
+   h.version = htole32(PERSON_FILE_VERSION);
+   h.header_size = htole32(sizeof(h));
+   h.count = htole64(n);
+   h.age_off = htole64(pos);
+   pos = ALIGN8(pos + n * sizeof(int32_t));
+   h.gender_off = htole64(pos);
+   pos = ALIGN8(pos + n);
+   h.first_name_off = htole64(pos);
+   pos = ALIGN8(pos + n * sizeof(uint32_t));
+   h.last_name_off = htole64(pos);
+   pos = ALIGN8(pos + n * sizeof(uint32_t));
+   h.strings_off = htole64(pos);
+   h.strings_len = htole64(pw->strings_len);
+
+   pos = sizeof(h);
+   int ret = 0;
+   if (fwrite(&h, sizeof(h), 1, pw->out) != 1
+         || append_section(pw->out, pw->age, &pos) == -1
+         || append_section(pw->out, pw->gender, &pos) == -1
+         || append_section(pw->out, pw->first_name, &pos) == -1
+         || append_section(pw->out, pw->last_name, &pos) == -1
+         || append_section(pw->out, pw->strings, &pos) == -1)
+      ret = -1;
+
+   FILE *out = pw->out;
+   pw->out = NULL;
+   if (fclose(out) == EOF)
+      ret = -1;
+   if (ret == 0 && rename(pw->tmp_path, pw->path) == -1)
+      ret = -1;
+   if (ret == -1) {
+      person_writer_abort(pw);
+      return -1;
+   }
+   writer_discard(pw);
+   return 0;
+}
+
+//Give up on the file: drop the spooled columns and remove the partial output
+void person_writer_abort(struct person_writer *pw) {
+   int saved = errno;
+
+   if (pw->tmp_path != NULL)
+      unlink(pw->tmp_path);
+   writer_discard(pw);
+   errno = saved;
+}
@@ -0,0 +1,107 @@
+#ifndef PERSON_FILE_H
+#define PERSON_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <endian.h>
+#include "person_store.h"
+
+//On-disk layout, all integers little-endian:
+//
+//   header                     struct person_file_header
+//   age column                 int32[count]
+//   gender column              uint8[count]
+//   first name column          uint32[count], offsets into the string table
+//   last name column           uint32[count], offsets into the string table
+//   string table               NUL-terminated names, ends with a NUL
+//
+//Every section starts on an 8-byte boundary and is located through the
+//header, so readers can use it straight out of an mmap.
+
+#define PERSON_FILE_MAGIC     "TLPIPERS"
+#define PERSON_FILE_VERSION   1
+
+struct person_file_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t header_size;
+   uint64_t count;
+   uint64_t age_off;
+   uint64_t gender_off;
+   uint64_t first_name_off;
+   uint64_t last_name_off;
+   uint64_t strings_off;
+   uint64_t strings_len;
+};
+
+//A mapped, validated file; column pointers point into the mapping
+struct person_file {
+   void *map;
+   size_t map_len;
+   size_t count;
+   const int32_t *age;
+   const uint8_t *gender;
+   const uint32_t *first_name;
+   const uint32_t *last_name;
+   const char *strings;
+   size_t strings_len;
+};
+
+int person_file_open(const char *path, struct person_file *pf);
+void person_file_close(struct person_file *pf);
+
+static inline int person_file_age(const struct person_file *pf, size_t i) {
+   return (int32_t)le32toh((uint32_t)pf->age[i]);
+}
+
+static inline char person_file_gender(const struct person_file *pf, size_t i) {
+   return pf->gender[i];
+}
+
+//Names out of range of the string table come back as NULL
+static inline const char *person_file_name(const struct person_file *pf, uint32_t ref) {
+   ref = le32toh(ref);
+   return ref < pf->strings_len ? pf->strings + ref : NULL;
+}
+
+static inline const char *person_file_first_name(const struct person_file *pf, size_t i) {
+   return person_file_name(pf, pf->first_name[i]);
+}
+
+static inline const char *person_file_last_name(const struct person_file *pf, size_t i) {
+   return person_file_name(pf, pf->last_name[i]);
+}
+
+#define PERSON_WRITER_CACHE   4096    //Recently written names, for dedupe
+#define PERSON_WRITER_NAME    32      //Longer names are never deduped
+
+struct person_writer_cache {
+   char name[PERSON_WRITER_NAME];
+   uint32_t ref;
+};
+
+//Streaming writer: columns are spooled to temporary files and stitched
+//together on close, so memory use doesn't grow with the record count.
+//The file is built as '<path>.tmp' and only renamed to 'path' once it is
+//complete, so a failed or aborted write never leaves a file behind.
+struct person_writer {
+   char *path;
+   char *tmp_path;
+   FILE *out;
+   FILE *age;
+   FILE *gender;
+   FILE *first_name;
+   FILE *last_name;
+   FILE *strings;
+   uint64_t count;
+   uint64_t strings_len;
+   struct person_writer_cache *cache;
+};
+
+int person_writer_open(const char *path, struct person_writer *pw);
+int person_writer_add(struct person_writer *pw, const struct person *p);
+int person_writer_close(struct person_writer *pw);
+void person_writer_abort(struct person_writer *pw);
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "person_store.h"
+
+#define INITIAL_RECORDS    1024
+#define INITIAL_NAMES      4096
+#define INITIAL_INTERN     1024
+
+//FNV-1a, plenty for short names
+static uint32_t hash_name(const char *s, size_t len) {
+   uint32_t h = 2166136261u;
+   for (size_t i = 0; i < len; ++i) {
+      h ^= (unsigned char)s[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static int grow(void **p, size_t *cap, size_t need, size_t elem) {
+   size_t n = *cap;
+   if (need <= n)
+      return 0;
+   while (n < need)
+      n *= 2;
+   void *q = realloc(*p, n * elem);
+   if (q == NULL)
+      return -1;
+   *p = q;
+   *cap = n;
+   return 0;
+}
+
+int person_store_init(struct person_store *ps) {
+   memset(ps, 0, sizeof(*ps));
+   ps->cap = INITIAL_RECORDS;
+   ps->names_cap = INITIAL_NAMES;
+   ps->intern_cap = INITIAL_INTERN;
+
+   ps->age = malloc(ps->cap * sizeof(*ps->age));
+   ps->gender = malloc(ps->cap * sizeof(*ps->gender));
+   ps->first_name = malloc(ps->cap * sizeof(*ps->first_name));
+   ps->last_name = malloc(ps->cap * sizeof(*ps->last_name));
+   ps->names = malloc(ps->names_cap);
+   ps->intern = malloc(ps->intern_cap * sizeof(*ps->intern));
+   if (!ps->age || !ps->gender || !ps->first_name || !ps->last_name || !ps->names || !ps->intern) {
+      person_store_free(ps);
+      errno = ENOMEM;
+      return -1;
+   }
+   memset(ps->intern, 0xff, ps->intern_cap * sizeof(*ps->intern));
+   return 0;
+}
+
+void person_store_free(struct person_store *ps) {
+   free(ps->age);
+   free(ps->gender);
+   free(ps->first_name);
+   free(ps->last_name);
+   free(ps->names);
+   free(ps->intern);
+   memset(ps, 0, sizeof(*ps));
+}
+
+//Find the table slot holding 'name', or the empty slot it would go in
+static size_t intern_slot(const struct person_store *ps, const char *name, size_t len) {
+   size_t mask = ps->intern_cap - 1;
+   size_t i = hash_name(name, len) & mask;
+
+   while (ps->intern[i] != PERSON_NO_NAME) {
+      const char *s = ps->names + ps->intern[i];
+      if (strncmp(s, name, len) == 0 && s[len] == '\0')
+         break;
+      i = (i + 1) & mask;
+   }
+   return i;
+}
+
+static int rehash(struct person_store *ps) {
+   size_t cap = ps->intern_cap * 2;
+   uint32_t *old = ps->intern;
+   size_t old_cap = ps->intern_cap;
+
+   ps->intern = malloc(cap * sizeof(*ps->intern));
+   if (ps->intern == NULL) {
+      ps->intern = old;
+      return -1;
+   }
+   memset(ps->intern, 0xff, cap * sizeof(*ps->intern));
+   ps->intern_cap = cap;
+
+   for (size_t i = 0; i < old_cap; ++i) {
+      if (old[i] == PERSON_NO_NAME)
+         continue;
+      const char *s = ps->names + old[i];
+      ps->intern[intern_slot(ps, s, strlen(s))] = old[i];
+   }
+   free(old);
+   return 0;
+}
+
+static uint32_t intern(struct person_store *ps, const char *name) {
+   size_t len = strlen(name);
+   size_t i = intern_slot(ps, name, len);
+
+   if (ps->intern[i] != PERSON_NO_NAME)
+      return ps->intern[i];
+
+   //Offsets must stay below both sentinels
+   if (ps->names_len + len + 1 >= PERSON_ANY_NAME) {
+      errno = EOVERFLOW;
+      return PERSON_NO_NAME;
+   }
+   if (grow((void **)&ps->names, &ps->names_cap, ps->names_len + len + 1, 1) == -1) {
+      errno = ENOMEM;
+      return PERSON_NO_NAME;
+   }
+
+   uint32_t ref = ps->names_len;
+   memcpy(ps->names + ref, name, len + 1);
+   ps->names_len += len + 1;
+
+   //Keep the load factor under 1/2
+   if (++ps->intern_count * 2 > ps->intern_cap) {
+      if (rehash(ps) == -1) {
+         errno = ENOMEM;
+         return PERSON_NO_NAME;
+      }
+      i = intern_slot(ps, name, len);
+   }
+   ps->intern[i] = ref;
+   return ref;
+}
+
+int person_store_insert(struct person_store *ps, const struct person *recs, size_t n) {
+   size_t need = ps->count + n;
+   size_t cap = ps->cap;
+
+   if (grow((void **)&ps->age, &cap, need, sizeof(*ps->age)) == -1)
+      goto nomem;
+   cap = ps->cap;
+   if (grow((void **)&ps->gender, &cap, need, sizeof(*ps->gender)) == -1)
+      goto nomem;
+   cap = ps->cap;
+   if (grow((void **)&ps->first_name, &cap, need, sizeof(*ps->first_name)) == -1)
+      goto nomem;
+   cap = ps->cap;
+   if (grow((void **)&ps->last_name, &cap, need, sizeof(*ps->last_name)) == -1)
+      goto nomem;
+   ps->cap = cap;
+
+   for (size_t i = 0; i < n; ++i) {
+      uint32_t first = intern(ps, recs[i].first_name);
+      uint32_t last = intern(ps, recs[i].last_name);
+      if (first == PERSON_NO_NAME || last == PERSON_NO_NAME)
+         return -1;
+
+      ps->age[ps->count] = recs[i].age;
+      ps->gender[ps->count] = recs[i].gender;
+      ps->first_name[ps->count] = first;
+      ps->last_name[ps->count] = last;
+      ++ps->count;
+   }
+   return 0;
+
+nomem:
+   errno = ENOMEM;
+   return -1;
+}
+
+//Returns the arena offset of an interned name, or PERSON_NO_NAME
+uint32_t person_store_lookup(const struct person_store *ps, const char *name) {
+   return ps->intern[intern_slot(ps, name, strlen(name))];
+}
+
+void person_store_scan(const struct person_store *ps, person_scan_fn fn, void *arg) {
+   for (size_t i = 0; i < ps->count; ++i)
+      fn(ps, i, arg);
+}
+
+//Collect indices of records matching all given criteria into 'out' (may be NULL
+//to just count). A 'gender' of 0 or a 'last_name' of PERSON_ANY_NAME matches any;
+//PERSON_NO_NAME (a failed lookup) matches none.
+//Interned names compare by offset, so no string compares are needed.
+size_t person_store_filter(const struct person_store *ps, int min_age, int max_age,
+      char gender, uint32_t last_name, size_t *out) {
+   size_t n = 0;
+
+   for (size_t i = 0; i < ps->count; ++i) {
+      int match = ps->age[i] >= min_age && ps->age[i] <= max_age;
+      if (gender)
+         match &= ps->gender[i] == gender;
+      if (last_name != PERSON_ANY_NAME)
+         match &= ps->last_name[i] == last_name;
+      if (out != NULL && match)
+         out[n] = i;
+      n += match;
+   }
+   return n;
+}
+
+//Bytes actually used by records and names (not counting slack capacity)
+size_t person_store_bytes(const struct person_store *ps) {
+   return ps->count * (sizeof(*ps->age) + sizeof(*ps->gender)
+         + sizeof(*ps->first_name) + sizeof(*ps->last_name))
+      + ps->names_len + ps->intern_cap * sizeof(*ps->intern);
+}
@@ -0,0 +1,55 @@
+#ifndef PERSON_STORE_H
+#define PERSON_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PERSON_NO_NAME  UINT32_MAX         //Unknown name, as returned by lookup
+#define PERSON_ANY_NAME (UINT32_MAX - 1)   //Filter wildcard; never a real offset
+
+//A record as handed in by callers; names are copied into the store
+struct person {
+   int age;
+   char gender;
+   const char *first_name;
+   const char *last_name;
+};
+
+//Structure-of-arrays record store. Names live once each in an interned
+//arena and records refer to them by 32-bit offset.
+struct person_store {
+   size_t count;
+   size_t cap;
+   int32_t *age;
+   char *gender;
+   uint32_t *first_name;
+   uint32_t *last_name;
+
+   char *names;            //Arena of NUL-terminated names
+   size_t names_len;
+   size_t names_cap;
+
+   uint32_t *intern;       //Open-addressing table of arena offsets
+   size_t intern_cap;      //Power of two
+   size_t intern_count;
+};
+
+typedef void (*person_scan_fn)(const struct person_store *ps, size_t i, void *arg);
+
+int person_store_init(struct person_store *ps);
+void person_store_free(struct person_store *ps);
+
+int person_store_insert(struct person_store *ps, const struct person *recs, size_t n);
+uint32_t person_store_lookup(const struct person_store *ps, const char *name);
+
+void person_store_scan(const struct person_store *ps, person_scan_fn fn, void *arg);
+size_t person_store_filter(const struct person_store *ps, int min_age, int max_age,
+      char gender, uint32_t last_name, size_t *out);
+
+size_t person_store_bytes(const struct person_store *ps);
+
+static inline const char *person_store_name(const struct person_store *ps, uint32_t ref) {
+   return ps->names + ref;
+}
+
+#endif
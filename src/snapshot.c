@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/videodev2.h>
+#include "snapshot.h"
+
+#define SNAPSHOT_REQUEST     'S'
+#define MAX_CLIENTS          64       //Connected but not yet answered
+#define CLIENT_TIMEOUT_MS    1000     //Silent clients are dropped after this
+#define FIRST_FRAME_POLL_MS  10       //Retry interval for clients awaiting a first frame
+
+//The daemon's only shared state: the newest sealed frame
+struct latest {
+   pthread_mutex_t lock;
+   int fd;                    //-1 until the first frame arrives
+   struct snapshot_header header;
+   struct frame_source *src;
+   int listen_fd;             //Shut down to wake the server when capture ends
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static uint64_t monotonic_ns(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//Stand-in source: a moving YUYV gradient at a fixed frame rate
+struct test_source {
+   unsigned char *frame;
+   size_t len;
+   uint64_t sequence;
+   struct timespec interval;
+};
+
+static int test_source_next(struct frame_source *src, const void **data, size_t *len) {
+   struct test_source *ts = src->ctx;
+
+   nanosleep(&ts->interval, NULL);
+   for (size_t i = 0; i < ts->len; i += 2) {
+      size_t x = (i / 2) % src->width;
+      ts->frame[i] = (unsigned char)(x + ts->sequence * 4);     //Y
+      ts->frame[i + 1] = 128;                                   //U/V
+   }
+   ++ts->sequence;
+
+   *data = ts->frame;
+   *len = ts->len;
+   return 0;
+}
+
+static int test_source_release(struct frame_source *src) {
+   (void)src;
+   return 0;
+}
+
+static void test_source_stop(struct frame_source *src) {
+   struct test_source *ts = src->ctx;
+   free(ts->frame);
+   free(ts);
+}
+
+int test_source_init(struct frame_source *src, uint32_t width, uint32_t height, int fps) {
+   struct test_source *ts = calloc(1, sizeof(*ts));
+   if (ts == NULL)
+      return -1;
+   ts->len = (size_t)width * height * 2;
+   ts->frame = malloc(ts->len);
+   if (ts->frame == NULL) {
+      free(ts);
+      return -1;
+   }
+   ts->interval.tv_nsec = 1000000000L / (fps > 0 ? fps : 30);
+
+   src->ctx = ts;
+   src->width = width;
+   src->height = height;
+   src->pixelformat = V4L2_PIX_FMT_YUYV;
+   src->next = test_source_next;
+   src->release = test_source_release;
+   src->stop = test_source_stop;
+   return 0;
+}
+
+//Copy a frame into a new memfd and seal it, so clients holding it
+//can never see it change underneath them
+static int seal_frame(const void *data, size_t len) {
+   int fd = memfd_create("g_photo-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+   if (fd == -1)
+      return -1;
+
+   const char *p = data;
+   size_t left = len;
+   while (left > 0) {
+      ssize_t w = write(fd, p, left);
+      if (w == -1) {
+         if (errno == EINTR)
+            continue;
+         close(fd);
+         return -1;
+      }
+      p += w;
+      left -= w;
+   }
+
+   if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+//Keep dequeuing frames so 'latest' always holds the newest one
+static void *capture_thread(void *arg) {
+   struct latest *l = arg;
+   struct frame_source *src = l->src;
+   uint64_t sequence = 0;
+
+   while (!stop_requested) {
+      const void *data;
+      size_t len;
+
+      int r = src->next(src, &data, &len);
+      if (r == 1)
+         continue;
+      if (r == -1) {
+         perror("Error capturing frame");
+         break;
+      }
+      uint64_t when = monotonic_ns();
+      int fd = seal_frame(data, len);
+      //A buffer that can't be handed back is lost for good; once they all
+      //are, next() would block forever, so stop now while we can say why
+      if (src->release(src) == -1) {
+         perror("Error releasing frame");
+         if (fd != -1)
+            close(fd);
+         break;
+      }
+      if (fd == -1) {
+         perror("Error sealing frame");
+         continue;
+      }
+
+      pthread_mutex_lock(&l->lock);
+      int old = l->fd;
+      l->fd = fd;
+      l->header.width = src->width;
+      l->header.height = src->height;
+      l->header.pixelformat = src->pixelformat;
+      l->header.bytesused = len;
+      l->header.sequence = sequence++;
+      l->header.timestamp_ns = when;
+      pthread_mutex_unlock(&l->lock);
+
+      //Clients already sent the old frame keep their own reference
+      if (old != -1)
+         close(old);
+   }
+
+   //Wake the server's poll() so it notices
+   stop_requested = 1;
+   shutdown(l->listen_fd, SHUT_RDWR);
+   return NULL;
+}
+
+//Send the header with the frame's fd attached as SCM_RIGHTS
+static int send_frame(int sock, const struct snapshot_header *h, int fd) {
+   union {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+   } control;
+   struct iovec iov = {(void *)h, sizeof(*h)};
+   struct msghdr msg;
+
+   memset(&msg, 0, sizeof(msg));
+   memset(&control, 0, sizeof(control));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control.buf;
+   msg.msg_controllen = sizeof(control.buf);
+
+   struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level = SOL_SOCKET;
+   cmsg->cmsg_type = SCM_RIGHTS;
+   cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+   memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+   return sendmsg(sock, &msg, MSG_NOSIGNAL) == sizeof(*h) ? 0 : -1;
+}
+
+static void handle_stop(int sig) {
+   (void)sig;
+   stop_requested = 1;
+}
+
+//Send the newest frame to a client that has asked for it. Returns -1
+//without waiting if there is no frame yet.
+static int answer_client(struct latest *l, int cfd) {
+   pthread_mutex_lock(&l->lock);
+   int fd = l->fd == -1 ? -1 : dup(l->fd);
+   struct snapshot_header h = l->header;
+   pthread_mutex_unlock(&l->lock);
+
+   if (fd == -1)
+      return -1;
+   if (send_frame(cfd, &h, fd) == -1)
+      perror("Error sending frame");
+   close(fd);
+   return 0;
+}
+
+//Serve the newest frame from 'src' to every client that connects to
+//'socket_path', until SIGINT/SIGTERM or the source fails
+int snapshot_serve(const char *socket_path, struct frame_source *src) {
+   struct latest l = {PTHREAD_MUTEX_INITIALIZER, -1, {0}, src, -1};
+   struct sockaddr_un addr;
+   struct sigaction sa;
+   pthread_t capture;
+
+   if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "Socket path too long: %s\n", socket_path);
+      return -1;
+   }
+
+   //No SA_RESTART, so poll() returns EINTR when we're asked to stop
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = handle_stop;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+
+   int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+   if (lfd == -1) {
+      perror("Error creating socket");
+      return -1;
+   }
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, socket_path);
+   unlink(socket_path);
+   if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(lfd, 16) == -1) {
+      perror("Error binding socket");
+      close(lfd);
+      return -1;
+   }
+
+   l.listen_fd = lfd;
+   if (pthread_create(&capture, NULL, capture_thread, &l) != 0) {
+      fprintf(stderr, "Error starting capture thread\n");
+      close(lfd);
+      unlink(socket_path);
+      return -1;
+   }
+   printf("Serving snapshots on %s\n", socket_path);
+   fflush(stdout);
+
+   //One poll() loop over the listening socket and every client still to
+   //be answered, so a slow or silent client never delays the others.
+   //Clients that ask before the first frame exists wait in the set too.
+   struct pollfd fds[1 + MAX_CLIENTS];
+   uint64_t deadline[1 + MAX_CLIENTS];
+   int waiting[1 + MAX_CLIENTS];
+   int nfds = 1, nwaiting = 0;
+   fds[0].fd = lfd;
+   fds[0].events = POLLIN;
+
+   while (!stop_requested) {
+      //Waiting clients are answered when the first frame lands, so look often
+      if (poll(fds, nfds, nwaiting ? FIRST_FRAME_POLL_MS : CLIENT_TIMEOUT_MS / 4) == -1) {
+         if (errno != EINTR)
+            perror("Error polling clients");
+         continue;
+      }
+      uint64_t now = monotonic_ns();
+
+      for (int i = nfds - 1; i >= 1; --i) {
+         int done = 0;
+         if (waiting[i]) {
+            //Nothing more is read from these, so any event means hangup
+            done = fds[i].revents || answer_client(&l, fds[i].fd) == 0;
+         } else if (fds[i].revents) {
+            char req;
+            ssize_t r = read(fds[i].fd, &req, 1);
+            if (r == 1 && req == SNAPSHOT_REQUEST && answer_client(&l, fds[i].fd) == -1) {
+               waiting[i] = 1;
+               fds[i].events = 0;
+               ++nwaiting;
+            } else {
+               done = r != -1 || (errno != EAGAIN && errno != EINTR) || now >= deadline[i];
+            }
+         } else {
+            done = now >= deadline[i];
+         }
+         if (done) {
+            nwaiting -= waiting[i];
+            close(fds[i].fd);
+            fds[i] = fds[--nfds];
+            deadline[i] = deadline[nfds];
+            waiting[i] = waiting[nfds];
+         }
+      }
+
+      if (fds[0].revents && !stop_requested) {
+         int cfd;
+         while ((cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) != -1) {
+            if (nfds == 1 + MAX_CLIENTS) {
+               close(cfd);
+               continue;
+            }
+            fds[nfds].fd = cfd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            waiting[nfds] = 0;
+            deadline[nfds++] = now + CLIENT_TIMEOUT_MS * 1000000ULL;
+         }
+         if (errno != EAGAIN && errno != EINTR && !stop_requested)
+            perror("Error accepting client");
+      }
+   }
+
+   for (int i = 1; i < nfds; ++i)
+      close(fds[i].fd);
+   printf("Stopping snapshot daemon\n");
+   pthread_join(capture, NULL);
+   close(lfd);
+   unlink(socket_path);
+   if (l.fd != -1)
+      close(l.fd);
+   return 0;
+}
+
+//Ask the daemon at 'socket_path' for its newest frame and save it to 'out_path'
+int snapshot_request(const char *socket_path, const char *out_path) {
+   struct snapshot_header h;
+   struct sockaddr_un addr;
+   union {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+   } control;
+   struct iovec iov = {&h, sizeof(h)};
+   struct msghdr msg;
+   char req = SNAPSHOT_REQUEST;
+   int fd = -1;
+
+   uint64_t start = monotonic_ns();
+
+   int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (sock == -1) {
+      perror("Error creating socket");
+      return -1;
+   }
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+   if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+      perror("Error connecting to snapshot daemon");
+      close(sock);
+      return -1;
+   }
+   if (write(sock, &req, 1) != 1) {
+      perror("Error sending request");
+      close(sock);
+      return -1;
+   }
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control.buf;
+   msg.msg_controllen = sizeof(control.buf);
+   ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+   close(sock);
+
+   struct cmsghdr *cmsg = n == sizeof(h) ? CMSG_FIRSTHDR(&msg) : NULL;
+   if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+   if (fd == -1) {
+      fprintf(stderr, "Error receiving frame from snapshot daemon\n");
+      return -1;
+   }
+
+   void *frame = mmap(NULL, h.bytesused, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (frame == MAP_FAILED) {
+      perror("Error mapping frame");
+      return -1;
+   }
+   uint64_t got = monotonic_ns();
+
+   printf("Snapshot: seq=%llu %ux%u bytes=%u latency=%.3f ms age=%.1f ms\n",
+         (unsigned long long)h.sequence, h.width, h.height, h.bytesused,
+         (got - start) / 1e6, (got - h.timestamp_ns) / 1e6);
+
+   FILE *out_fp = fopen(out_path, "wb");
+   if (out_fp == NULL) {
+      perror("Error opening output file");
+      munmap(frame, h.bytesused);
+      return -1;
+   }
+   fwrite(frame, 1, h.bytesused, out_fp);
+   fclose(out_fp);
+   munmap(frame, h.bytesused);
+   return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Anything that produces a stream of frames: the camera, or a stand-in for tests
+struct frame_source {
+   void *ctx;
+   uint32_t width;
+   uint32_t height;
+   uint32_t pixelformat;
+   //Wait for the next frame and point 'data' at it. Returns 0 with a frame,
+   //1 if none arrived within a short timeout (so the caller can check
+   //whether to stop before calling again), or -1 on error.
+   int (*next)(struct frame_source *src, const void **data, size_t *len);
+   //Hand the frame from next() back to the source
+   int (*release)(struct frame_source *src);
+   void (*stop)(struct frame_source *src);
+};
+
+//Sent ahead of the frame's memfd on every snapshot
+struct snapshot_header {
+   uint32_t width;
+   uint32_t height;
+   uint32_t pixelformat;
+   uint32_t bytesused;
+   uint64_t sequence;
+   uint64_t timestamp_ns;     //CLOCK_MONOTONIC time the frame was captured
+};
+
+int test_source_init(struct frame_source *src, uint32_t width, uint32_t height, int fps);
+
+int snapshot_serve(const char *socket_path, struct frame_source *src);
+int snapshot_request(const char *socket_path, const char *out_path);
+
+#endif
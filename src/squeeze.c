@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "squeeze.h"
+
+struct slot {
+   char *out;
+   size_t len;
+   long chunk;    //Chunk held by this slot, -1 when free
+};
+
+struct pool {
+   const char *in;
+   size_t in_len;
+   long nchunks;
+   long next_chunk;     //Next chunk a worker will claim
+   long written;        //Chunks already written out, in order
+   int window;          //Slots in the reorder buffer
+   struct slot *slots;
+   pthread_mutex_t lock;
+   pthread_cond_t slot_free;
+   pthread_cond_t slot_ready;
+};
+
+//Squeeze runs of spaces/tabs in 'in' down to their first character.
+//'prev_is_space' is the carried state: whether the byte just before 'in' was a blank.
+size_t squeeze(const char *in, size_t len, char *out, int prev_is_space) {
+   size_t n = 0;
+
+   for (size_t i = 0; i < len; ++i) {
+      char c = in[i];
+      if (c == ' ' || c == '\t') {
+         if (!prev_is_space) {
+            out[n++] = c;
+            prev_is_space = 1;
+         }
+      } else {
+         out[n++] = c;
+         prev_is_space = 0;
+      }
+   }
+
+   return n;
+}
+
+int write_all(int fd, const char *buf, size_t len) {
+   while (len > 0) {
+      ssize_t w = write(fd, buf, len);
+      if (w == -1) {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      buf += w;
+      len -= w;
+   }
+   return 0;
+}
+
+int squeeze_serial(int in_fd, int out_fd) {
+   static char in[CHUNK_SIZE], out[CHUNK_SIZE];
+   int prev_is_space = 0;
+   ssize_t r;
+
+   while ((r = read(in_fd, in, sizeof(in))) != 0) {
+      if (r == -1) {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      size_t n = squeeze(in, r, out, prev_is_space);
+      prev_is_space = (in[r - 1] == ' ' || in[r - 1] == '\t');
+      if (write_all(out_fd, out, n) == -1)
+         return -1;
+   }
+   return 0;
+}
+
+static void *worker(void *arg) {
+   struct pool *p = arg;
+
+   for (;;) {
+      pthread_mutex_lock(&p->lock);
+      //Don't run further ahead of the writer than the reorder buffer allows
+      while (p->next_chunk < p->nchunks && p->next_chunk >= p->written + p->window)
+         pthread_cond_wait(&p->slot_free, &p->lock);
+      if (p->next_chunk >= p->nchunks) {
+         pthread_mutex_unlock(&p->lock);
+         return NULL;
+      }
+      long k = p->next_chunk++;
+      pthread_mutex_unlock(&p->lock);
+
+      size_t start = (size_t)k * CHUNK_SIZE;
+      size_t len = p->in_len - start < CHUNK_SIZE ? p->in_len - start : CHUNK_SIZE;
+      //The carried byte: chunk boundaries are fixed up by looking one byte back
+      int prev_is_space = start > 0 && (p->in[start - 1] == ' ' || p->in[start - 1] == '\t');
+      struct slot *s = &p->slots[k % p->window];
+      s->len = squeeze(p->in + start, len, s->out, prev_is_space);
+
+      pthread_mutex_lock(&p->lock);
+      s->chunk = k;
+      pthread_cond_broadcast(&p->slot_ready);
+      pthread_mutex_unlock(&p->lock);
+   }
+}
+
+//Squeeze an in-memory buffer chunk by chunk through one output buffer
+static int squeeze_buffer(const char *in, size_t in_len, char *out, int out_fd) {
+   for (size_t start = 0; start < in_len; start += CHUNK_SIZE) {
+      size_t len = in_len - start < CHUNK_SIZE ? in_len - start : CHUNK_SIZE;
+      int prev_is_space = start > 0 && (in[start - 1] == ' ' || in[start - 1] == '\t');
+      if (write_all(out_fd, out, squeeze(in + start, len, out, prev_is_space)) == -1)
+         return -1;
+   }
+   return 0;
+}
+
+int squeeze_parallel(const char *in, size_t in_len, int out_fd, int nthreads) {
+   struct pool p;
+   pthread_t tids[MAX_THREADS];
+   int started = 0, ret = 0;
+
+   if (nthreads < 1)
+      nthreads = 1;
+   if (nthreads > MAX_THREADS)
+      nthreads = MAX_THREADS;
+
+   memset(&p, 0, sizeof(p));
+   p.in = in;
+   p.in_len = in_len;
+   p.nchunks = (in_len + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   p.window = 2 * nthreads;
+   pthread_mutex_init(&p.lock, NULL);
+   pthread_cond_init(&p.slot_free, NULL);
+   pthread_cond_init(&p.slot_ready, NULL);
+
+   p.slots = calloc(p.window, sizeof(struct slot));
+   if (p.slots == NULL)
+      return -1;
+   for (int i = 0; i < p.window; ++i) {
+      p.slots[i].chunk = -1;
+      p.slots[i].out = malloc(CHUNK_SIZE);
+      if (p.slots[i].out == NULL) {
+         ret = -1;
+         goto cleanup;
+      }
+   }
+
+   //Carry on with however many workers we get; with none, do it ourselves
+   while (started < nthreads && pthread_create(&tids[started], NULL, worker, &p) == 0)
+      ++started;
+   if (started == 0) {
+      ret = squeeze_buffer(in, in_len, p.slots[0].out, out_fd);
+      goto cleanup;
+   }
+
+   //Reorder buffer: write chunks strictly in input order as they complete
+   for (long k = 0; k < p.nchunks; ++k) {
+      struct slot *s = &p.slots[k % p.window];
+
+      pthread_mutex_lock(&p.lock);
+      while (s->chunk != k)
+         pthread_cond_wait(&p.slot_ready, &p.lock);
+      pthread_mutex_unlock(&p.lock);
+
+      if (ret == 0 && write_all(out_fd, s->out, s->len) == -1)
+         ret = -1;
+
+      pthread_mutex_lock(&p.lock);
+      s->chunk = -1;
+      ++p.written;
+      pthread_cond_broadcast(&p.slot_free);
+      pthread_mutex_unlock(&p.lock);
+   }
+
+   for (int i = 0; i < started; ++i)
+      pthread_join(tids[i], NULL);
+
+cleanup:
+   for (int i = 0; i < p.window; ++i)
+      free(p.slots[i].out);
+   free(p.slots);
+   pthread_cond_destroy(&p.slot_ready);
+   pthread_cond_destroy(&p.slot_free);
+   pthread_mutex_destroy(&p.lock);
+   return ret;
+}
+
+//Squeeze an opened file, going parallel only for large regular files
+int squeeze_file(int fd, int out_fd, int nthreads) {
+   struct stat sb;
+
+   if (fstat(fd, &sb) == -1)
+      return -1;
+   if (nthreads <= 1 || !S_ISREG(sb.st_mode) || sb.st_size < PARALLEL_MIN)
+      return squeeze_serial(fd, out_fd);
+
+   char *in = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (in == MAP_FAILED)
+      return -1;
+   madvise(in, sb.st_size, MADV_SEQUENTIAL);
+
+   int ret = squeeze_parallel(in, sb.st_size, out_fd, nthreads);
+   munmap(in, sb.st_size);
+   return ret;
+}
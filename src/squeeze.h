@@ -0,0 +1,16 @@
+#ifndef SQUEEZE_H
+#define SQUEEZE_H
+
+#include <stddef.h>
+
+#define CHUNK_SIZE      (4 * 1024 * 1024)
+#define PARALLEL_MIN    (2 * CHUNK_SIZE)  //Smaller files aren't worth waking threads for
+#define MAX_THREADS     64
+
+size_t squeeze(const char *in, size_t len, char *out, int prev_is_space);
+int write_all(int fd, const char *buf, size_t len);
+int squeeze_serial(int in_fd, int out_fd);
+int squeeze_parallel(const char *in, size_t in_len, int out_fd, int nthreads);
+int squeeze_file(int fd, int out_fd, int nthreads);
+
+#endif
@@ -1,4 +1,15 @@
+//Build: cc -O2 structs.c person_store.c person_file.c
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "person_file.h"
+#include "person_store.h"
+#include "../lib/bench.h"
+
+#define BATCH_SIZE      4096
+#define MAX_STRUCTS     10000    //Fixed-size structs are 16KB each, cap the baseline
 
 struct Person {
    int age;
@@ -7,10 +18,215 @@ struct Person {
    char last_name[BUFSIZ];
 };
 
-int main() {
+const char *first_names[] = {"Gabriel", "Alice", "Bob", "Chloe", "David", "Emma", "Farid", "Grace"};
+const char *last_names[] = {"Lepoutre", "Smith", "Nguyen", "Garcia", "Kowalski", "Okafor", "Tanaka"};
+
+#define NELEMS(a)    (sizeof(a) / sizeof((a)[0]))
+
+void usage(char *program_name) {
+   printf("Usage: %s [-b records] [-w file -n records] [-r file]\n", program_name);
+   printf("Options:\n");
+   printf("\t-b\tBenchmark the record store against struct Person\n");
+   printf("\t-w\tWrite records to a binary Person file\n");
+   printf("\t-r\tMap a binary Person file and benchmark it against deserializing\n");
+   exit(EXIT_FAILURE);
+}
+
+void make_person(size_t i, struct person *p) {
+   p->age = 18 + i % 70;
+   p->gender = (i & 1) ? 'F' : 'M';
+   p->first_name = first_names[(i * 7) % NELEMS(first_names)];
+   p->last_name = last_names[(i * 13) % NELEMS(last_names)];
+}
+
+//Scan: count women over 40 named Smith, the same query for both layouts
+size_t scan_structs(const struct Person *people, size_t n) {
+   size_t hits = 0;
+   for (size_t i = 0; i < n; ++i)
+      hits += people[i].age > 40 && people[i].gender == 'F'
+         && strcmp(people[i].last_name, "Smith") == 0;
+   return hits;
+}
+
+size_t scan_store(const struct person_store *ps) {
+   return person_store_filter(ps, 41, 1 << 30, 'F', person_store_lookup(ps, "Smith"), NULL);
+}
+
+int benchmark(size_t nrecords) {
+   struct person_store ps;
+   struct person batch[BATCH_SIZE];
+   size_t nstructs = nrecords < MAX_STRUCTS ? nrecords : MAX_STRUCTS;
+   double t;
+
+   //Baseline: the fixed-size struct
+   struct Person *people = calloc(nstructs, sizeof(struct Person));
+   if (people == NULL) {
+      perror("Error allocating structs");
+      return 1;
+   }
+   for (size_t i = 0; i < nstructs; ++i) {
+      struct person p;
+      make_person(i, &p);
+      people[i].age = p.age;
+      people[i].gender = p.gender;
+      strcpy(people[i].first_name, p.first_name);
+      strcpy(people[i].last_name, p.last_name);
+   }
+   t = benchNow();
+   size_t struct_hits = scan_structs(people, nstructs);
+   t = benchNow() - t;
+   printf("struct Person:\t%zu records, %zu bytes/record, %.1f M records/s scanned (%zu hits)\n",
+         nstructs, sizeof(struct Person), nstructs / t / 1e6, struct_hits);
+   free(people);
+
+   //Record store, filled in bulk batches
+   if (person_store_init(&ps) == -1) {
+      perror("Error initializing record store");
+      return 1;
+   }
+   t = benchNow();
+   for (size_t i = 0; i < nrecords; i += BATCH_SIZE) {
+      size_t n = nrecords - i < BATCH_SIZE ? nrecords - i : BATCH_SIZE;
+      for (size_t j = 0; j < n; ++j)
+         make_person(i + j, &batch[j]);
+      if (person_store_insert(&ps, batch, n) == -1) {
+         perror("Error inserting records");
+         person_store_free(&ps);
+         return 1;
+      }
+   }
+   double insert_t = benchNow() - t;
+
+   t = benchNow();
+   size_t store_hits = scan_store(&ps);
+   t = benchNow() - t;
+   printf("person_store:\t%zu records, %.2f bytes/record, %.1f M records/s scanned (%zu hits), %.1f M records/s inserted\n",
+         ps.count, (double)person_store_bytes(&ps) / ps.count, ps.count / t / 1e6,
+         store_hits, ps.count / insert_t / 1e6);
+
+   person_store_free(&ps);
+   return 0;
+}
+
+int write_file(const char *path, size_t nrecords) {
+   struct person_writer pw;
+   struct person p;
+
+   if (person_writer_open(path, &pw) == -1) {
+      perror("Error opening Person file for writing");
+      return 1;
+   }
+   double t = benchNow();
+   for (size_t i = 0; i < nrecords; ++i) {
+      make_person(i, &p);
+      if (person_writer_add(&pw, &p) == -1) {
+         perror("Error writing record");
+         person_writer_abort(&pw);
+         return 1;
+      }
+   }
+   if (person_writer_close(&pw) == -1) {
+      perror("Error finishing Person file");
+      return 1;
+   }
+   t = benchNow() - t;
+   printf("Wrote %zu records to %s in %.3fs\n", nrecords, path, t);
+   return 0;
+}
+
+int read_file(const char *path) {
+   struct person_file pf;
+   struct person_store ps;
+   struct person batch[BATCH_SIZE];
+   double t;
+
+   //Zero-copy: map the file and query it in place
+   t = benchNow();
+   if (person_file_open(path, &pf) == -1) {
+      perror("Error opening Person file");
+      return 1;
+   }
+   double open_t = benchNow() - t;
+
+   t = benchNow();
+   size_t hits = 0;
+   for (size_t i = 0; i < pf.count; ++i) {
+      if (person_file_age(&pf, i) > 40 && person_file_gender(&pf, i) == 'F') {
+         const char *last = person_file_last_name(&pf, i);
+         hits += last != NULL && strcmp(last, "Smith") == 0;
+      }
+   }
+   double scan_t = benchNow() - t;
+   printf("mmap:\t\t%zu records opened in %.6fs, scanned in %.3fs (%zu hits)\n",
+         pf.count, open_t, scan_t, hits);
+
+   //Baseline: deserialize every record into a record store before querying
+   if (person_store_init(&ps) == -1) {
+      perror("Error initializing record store");
+      person_file_close(&pf);
+      return 1;
+   }
+   t = benchNow();
+   for (size_t i = 0; i < pf.count; i += BATCH_SIZE) {
+      size_t n = pf.count - i < BATCH_SIZE ? pf.count - i : BATCH_SIZE;
+      for (size_t j = 0; j < n; ++j) {
+         batch[j].age = person_file_age(&pf, i + j);
+         batch[j].gender = person_file_gender(&pf, i + j);
+         batch[j].first_name = person_file_first_name(&pf, i + j);
+         batch[j].last_name = person_file_last_name(&pf, i + j);
+         if (batch[j].first_name == NULL || batch[j].last_name == NULL) {
+            fprintf(stderr, "Corrupt name in record %zu\n", i + j);
+            person_store_free(&ps);
+            person_file_close(&pf);
+            return 1;
+         }
+      }
+      if (person_store_insert(&ps, batch, n) == -1) {
+         perror("Error inserting records");
+         person_store_free(&ps);
+         person_file_close(&pf);
+         return 1;
+      }
+   }
+   double load_t = benchNow() - t;
+   printf("deserialize:\t%zu records loaded in %.3fs (%zu hits)\n",
+         ps.count, load_t, scan_store(&ps));
+
+   person_store_free(&ps);
+   person_file_close(&pf);
+   return 0;
+}
+
+int main(int argc, char *argv[]) {
+   const char *write_path = NULL;
+   size_t nrecords = 0;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "b:w:n:r:")) != -1) {
+      switch (opt) {
+         case 'b':
+            nrecords = strtoul(optarg, NULL, 10);
+            if (nrecords == 0)
+               usage(argv[0]);
+            return benchmark(nrecords);
+         case 'w':
+            write_path = optarg;
+            break;
+         case 'n':
+            nrecords = strtoul(optarg, NULL, 10);
+            break;
+         case 'r':
+            return read_file(optarg);
+         default:
+            usage(argv[0]);
+      }
+   }
+   if (write_path != NULL)
+      return write_file(write_path, nrecords);
+
    struct Person gabe = {31, 'M', "Gabriel", "Lepoutre"};
 
    printf("%s %s is %d years old and is %c\n", gabe.first_name, gabe.last_name, gabe.age, gabe.gender);
-   
+
    return 0;
-}
\ No newline at end of file
+}
@@ -1,10 +1,215 @@
+//Build: cc -O2 temperature.c units.c ../lib/get_num_bulk.c -lm
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "../lib/get_num.h"
+#include "units.h"
+#include "../lib/bench.h"
 
 #define	LOWER		0
 #define	UPPER		300
 #define 	STEP		20
 
-int main() {
+#define	IN_BUF		(1 << 20)
+#define	BATCH		4096
+#define	DELIMS		" \t\r\n,"
+
+void usage(char *program_name) {
+	printf("Usage: %s [-f unit] [-t unit] [-p decimals] [-b count] [file]\n", program_name);
+	printf("Options:\n");
+	printf("\t-f\tUnit to convert from: F, C or K (default: F)\n");
+	printf("\t-t\tUnit to convert to: F, C or K (default: C)\n");
+	printf("\t-p\tDigits after the decimal point (default: 1)\n");
+	printf("\t-b\tBenchmark batch conversion of count values against printf\n");
+	printf("With -f, -t or a file, numbers are read from the file (or stdin) and\n");
+	printf("converted one per output line; otherwise the F to C table is printed.\n");
+	exit(EXIT_FAILURE);
+}
+
+//Convert every number in 'in', writing one formatted result per line
+int convert_stream(FILE *in, struct affine a, int decimals) {
+	static char buf[IN_BUF];
+	static double vals[BATCH];
+	static char out[BATCH * 33];
+	size_t have = 0, offset = 0;
+	int eof = 0;
+
+	while (!eof || have > 0) {
+		//read() rather than fread(), which on a pipe would sit on what has
+		//arrived until it could fill the whole buffer
+		if (!eof) {
+			ssize_t r = read(fileno(in), buf + have, IN_BUF - have);
+			if (r == -1) {
+				if (errno == EINTR)
+					continue;
+				perror("Error reading input");
+				return 1;
+			}
+			if (r == 0)
+				eof = 1;
+			have += r;
+		}
+
+		//Only parse complete numbers: stop at the last delimiter until EOF
+		size_t end = have;
+		if (!eof) {
+			while (end > 0 && strchr(DELIMS, buf[end - 1]) == NULL)
+				--end;
+			if (end == 0) {
+				if (have == IN_BUF) {
+					fprintf(stderr, "Number too long near byte %zu\n", offset);
+					return 1;
+				}
+				continue;
+			}
+		}
+
+		size_t pos = 0, count, consumed;
+		do {
+			int status = getDoubles(buf + pos, end - pos, DELIMS, 0, vals, BATCH, &count, &consumed);
+			convert_doubles(a, vals, vals, count);
+
+			//Flush early rather than size 'out' for BATCH huge values
+			size_t o = 0;
+			for (size_t i = 0; i < count; ++i) {
+				if (o + FORMAT_FIXED_MAX + 1 > sizeof(out)) {
+					fwrite(out, 1, o, stdout);
+					o = 0;
+				}
+				o += format_fixed(vals[i], decimals, out + o);
+				out[o++] = '\n';
+			}
+			fwrite(out, 1, o, stdout);
+
+			pos += consumed;
+			if (status != GN_OK) {
+				fprintf(stderr, "Bad number at byte %zu: %s\n", offset + pos, gnStrError(status));
+				return 1;
+			}
+		} while (count == BATCH);
+
+		memmove(buf, buf + end, have - end);
+		have -= end;
+		offset += end;
+
+		//Results go out as soon as their input has arrived
+		if (fflush(stdout) == EOF) {
+			perror("Error writing output");
+			return 1;
+		}
+	}
+
+	if (fflush(stdout) == EOF) {
+		perror("Error writing output");
+		return 1;
+	}
+	return 0;
+}
+
+int benchmark(size_t n) {
+	double *in = malloc(n * sizeof(double));
+	double *out = malloc(n * sizeof(double));
+	float *in_f = malloc(n * sizeof(float));
+	float *out_f = malloc(n * sizeof(float));
+	char *text = malloc(n * 33 + FORMAT_FIXED_MAX);
+	FILE *null = fopen("/dev/null", "w");
+	struct affine f_to_c = unit_conversion(UNIT_F, UNIT_C);
+	double t;
+
+	if (!in || !out || !in_f || !out_f || !text || !null) {
+		perror("Error setting up benchmark");
+		return 1;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		in[i] = LOWER + (double)(i % (UPPER - LOWER + 1));
+		in_f[i] = in[i];
+	}
+
+	//The original loop: compute and printf each value
+	t = benchNow();
+	for (size_t i = 0; i < n; ++i)
+		fprintf(null, "%6.1f\n", (5.0/9.0)*(in[i]-32));
+	t = benchNow() - t;
+	printf("printf loop:\t%8.1f M values/s\n", n / t / 1e6);
+
+	t = benchNow();
+	convert_doubles(f_to_c, in, out, n);
+	t = benchNow() - t;
+	printf("double kernel:\t%8.1f M values/s\n", n / t / 1e6);
+
+	t = benchNow();
+	convert_floats(f_to_c, in_f, out_f, n);
+	t = benchNow() - t;
+	printf("float kernel:\t%8.1f M values/s\n", n / t / 1e6);
+
+	t = benchNow();
+	convert_doubles(f_to_c, in, out, n);
+	size_t o = 0;
+	for (size_t i = 0; i < n; ++i) {
+		o += format_fixed(out[i], 1, text + o);
+		text[o++] = '\n';
+	}
+	fwrite(text, 1, o, null);
+	t = benchNow() - t;
+	printf("batch + format:\t%8.1f M values/s\n", n / t / 1e6);
+
+	fclose(null);
+	free(text);
+	free(out_f);
+	free(in_f);
+	free(out);
+	free(in);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	enum unit from = UNIT_F, to = UNIT_C;
+	int decimals = 1, streaming = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:t:p:b:")) != -1) {
+		switch (opt) {
+			case 'f':
+				if (unit_parse(optarg, &from) == -1)
+					usage(argv[0]);
+				streaming = 1;
+				break;
+			case 't':
+				if (unit_parse(optarg, &to) == -1)
+					usage(argv[0]);
+				streaming = 1;
+				break;
+			case 'p':
+				decimals = atoi(optarg);
+				break;
+			case 'b':
+				if (atol(optarg) <= 0)
+					usage(argv[0]);
+				return benchmark(atol(optarg));
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (streaming || optind < argc) {
+		FILE *in = stdin;
+		if (optind < argc && strcmp(argv[optind], "-") != 0) {
+			in = fopen(argv[optind], "r");
+			if (in == NULL) {
+				perror("Error opening input file");
+				return 1;
+			}
+		}
+		int ret = convert_stream(in, unit_conversion(from, to), decimals);
+		if (in != stdin)
+			fclose(in);
+		return ret;
+	}
+
 	int F;
 
 	printf("F\tC\n");
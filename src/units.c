@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "units.h"
+
+//Vectors of 32 bytes: the compiler maps these onto AVX, SSE or NEON
+//registers (or plain scalar code) depending on the target flags
+typedef double v4d __attribute__((vector_size(32)));
+typedef float v8f __attribute__((vector_size(32)));
+
+//Each unit as an affine map into Kelvin
+static const struct affine to_kelvin[UNIT_COUNT] = {
+   [UNIT_F] = {5.0 / 9.0, 273.15 - 32.0 * 5.0 / 9.0},
+   [UNIT_C] = {1.0, 273.15},
+   [UNIT_K] = {1.0, 0.0},
+};
+
+static const char *unit_names[UNIT_COUNT] = {
+   [UNIT_F] = "F",
+   [UNIT_C] = "C",
+   [UNIT_K] = "K",
+};
+
+int unit_parse(const char *name, enum unit *u) {
+   for (int i = 0; i < UNIT_COUNT; ++i) {
+      if (strcasecmp(name, unit_names[i]) == 0) {
+         *u = i;
+         return 0;
+      }
+   }
+   return -1;
+}
+
+//Apply 'first' and then 'then'
+struct affine affine_compose(struct affine first, struct affine then) {
+   struct affine a = {then.scale * first.scale, then.scale * first.offset + then.offset};
+   return a;
+}
+
+struct affine affine_inverse(struct affine a) {
+   struct affine inv = {1.0 / a.scale, -a.offset / a.scale};
+   return inv;
+}
+
+struct affine unit_conversion(enum unit from, enum unit to) {
+   if (from == to) {
+      struct affine id = {1.0, 0.0};
+      return id;
+   }
+   return affine_compose(to_kelvin[from], affine_inverse(to_kelvin[to]));
+}
+
+void convert_doubles(struct affine a, const double *in, double *out, size_t n) {
+   const v4d scale = {a.scale, a.scale, a.scale, a.scale};
+   const v4d offset = {a.offset, a.offset, a.offset, a.offset};
+   size_t i = 0;
+
+   for (; i + 4 <= n; i += 4) {
+      v4d x;
+      memcpy(&x, in + i, sizeof(x));
+      x = x * scale + offset;
+      memcpy(out + i, &x, sizeof(x));
+   }
+   for (; i < n; ++i)
+      out[i] = a.scale * in[i] + a.offset;
+}
+
+void convert_floats(struct affine a, const float *in, float *out, size_t n) {
+   const float s = a.scale, o = a.offset;
+   const v8f scale = {s, s, s, s, s, s, s, s};
+   const v8f offset = {o, o, o, o, o, o, o, o};
+   size_t i = 0;
+
+   for (; i + 8 <= n; i += 8) {
+      v8f x;
+      memcpy(&x, in + i, sizeof(x));
+      x = x * scale + offset;
+      memcpy(out + i, &x, sizeof(x));
+   }
+   for (; i < n; ++i)
+      out[i] = s * in[i] + o;
+}
+
+//Format 'v' with 'decimals' (0-9) digits after the point into 'out', which
+//must hold FORMAT_FIXED_MAX bytes; returns the length. Output is the same
+//as printf("%.*f"): values whose scaled magnitude reaches 2^52, NaN and
+//inf are formatted by snprintf itself, which for large values may take
+//hundreds of digits.
+size_t format_fixed(double v, int decimals, char *out) {
+   static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+   char digits[24];
+   size_t n = 0, len = 0;
+
+   if (decimals < 0)
+      decimals = 0;
+   if (decimals > 9)
+      decimals = 9;
+
+   //Below 2^52 the scaled value has at least one bit after the point,
+   //so floor() and the subtraction below are exact
+   double scaled = fabs(v) * pow10[decimals];
+   if (!(scaled < 4503599627370496.0))
+      return snprintf(out, FORMAT_FIXED_MAX, "%.*f", decimals, v);
+
+   //Round as printf does: to nearest on the exact binary value, ties to
+   //even. fma() gives the rounding error of the product exactly, so the
+   //exact product is scaled + err and its distance from the midpoint is
+   //(scaled - whole - 0.5) + err, whose sign survives the final rounding.
+   double err = fma(fabs(v), pow10[decimals], -scaled);
+   double whole = floor(scaled);
+   double above = (scaled - whole - 0.5) + err;
+   unsigned long long q = whole;
+   if (above > 0 || (above == 0 && (q & 1)))
+      ++q;
+   do {
+      digits[n++] = '0' + q % 10;
+      q /= 10;
+   } while (q > 0 || n <= (size_t)decimals);   //At least one integer digit
+
+   if (signbit(v))
+      out[len++] = '-';
+   while (n > (size_t)decimals)
+      out[len++] = digits[--n];
+   if (decimals > 0) {
+      out[len++] = '.';
+      while (n > 0)
+         out[len++] = digits[--n];
+   }
+   out[len] = '\0';
+   return len;
+}
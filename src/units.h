@@ -0,0 +1,33 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <stddef.h>
+
+//A linear unit conversion: out = scale * in + offset
+struct affine {
+   double scale;
+   double offset;
+};
+
+enum unit {
+   UNIT_F,
+   UNIT_C,
+   UNIT_K,
+   UNIT_COUNT
+};
+
+int unit_parse(const char *name, enum unit *u);
+struct affine unit_conversion(enum unit from, enum unit to);
+struct affine affine_compose(struct affine first, struct affine then);
+struct affine affine_inverse(struct affine a);
+
+void convert_doubles(struct affine a, const double *in, double *out, size_t n);
+void convert_floats(struct affine a, const float *in, float *out, size_t n);
+
+//Longest format_fixed() result plus its NUL: sign, the 309 integer digits
+//of DBL_MAX, the point and 9 decimals
+#define FORMAT_FIXED_MAX   328
+
+size_t format_fixed(double v, int decimals, char *out);
+
+#endif
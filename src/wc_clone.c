@@ -1,29 +1,123 @@
+//Build: cc -O2 wc_clone.c wc_count.c word_freq.c
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "wc_count.h"
+#include "word_freq.h"
 
-#define     IN    1
-#define     OUT   0
+#define READ_SIZE   (64 * 1024)
 
-int main() {
-   int character, newlines, num_words, num_chars, state;
+static int feed_fd(struct word_freq *wf, int fd, const char *name) {
+   static char buf[READ_SIZE];
+   ssize_t n;
 
-   state = OUT;
-   newlines = num_words = num_chars = 0;
+   while ((n = read(fd, buf, sizeof(buf))) != 0) {
+      if (n == -1) {
+         if (errno == EINTR)
+            continue;
+         fprintf(stderr, "Error reading %s: ", name);
+         perror(NULL);
+         return -1;
+      }
+      if (word_freq_feed(wf, buf, n) == -1) {
+         perror("Error counting words");
+         return -1;
+      }
+   }
+   return 0;
+}
+
+//Print the 'top_n' most frequent words in the files (or stdin) like
+//uniq -c; counts prefixed with '~' are upper-bound estimates
+static int word_frequencies(char *files[], int nfiles, size_t top_n, size_t mem_limit) {
+   struct word_freq *wf = word_freq_create(mem_limit, top_n);
+   if (wf == NULL) {
+      perror("Error creating word table");
+      return 1;
+   }
+
+   int status = 0;
+   if (nfiles == 0)
+      status = feed_fd(wf, STDIN_FILENO, "stdin");
+   for (int i = 0; i < nfiles && status == 0; ++i) {
+      int fd = open(files[i], O_RDONLY);
+      if (fd == -1) {
+         fprintf(stderr, "Error opening %s: ", files[i]);
+         perror(NULL);
+         status = -1;
+         break;
+      }
+      status = feed_fd(wf, fd, files[i]);
+      close(fd);
+   }
+   if (status == 0 && word_freq_finish(wf) == -1) {
+      perror("Error counting words");
+      status = -1;
+   }
+
+   struct word_count *top = malloc((top_n ? top_n : 1) * sizeof(*top));
+   if (status == 0 && top != NULL) {
+      size_t n = word_freq_top(wf, top);
+      for (size_t i = 0; i < n; ++i)
+         printf("%s%7llu %.*s\n", top[i].approximate ? "~" : " ",
+               (unsigned long long)top[i].count, (int)top[i].len, top[i].word);
+      if (wf->overflow_words > 0)
+         fprintf(stderr, "Memory limit reached: %zu distinct words counted exactly, "
+               "%llu occurrences estimated\n", wf->distinct,
+               (unsigned long long)wf->overflow_words);
+   } else if (top == NULL) {
+      perror("Error allocating results");
+      status = -1;
+   }
+
+   free(top);
+   word_freq_destroy(wf);
+   return status == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+   char buf[BUFSIZ];
+   struct wc_counts counts = {0, 0, 0, OUT};
+   ssize_t n;
+   int freq = 0, opt;
+   size_t top_n = 10, mem_limit = 0;
+
+   while ((opt = getopt(argc, argv, "fn:m:")) != -1) {
+      switch (opt) {
+         case 'f':
+            freq = 1;
+            break;
+         case 'n':
+            top_n = strtoul(optarg, NULL, 10);
+            break;
+         case 'm':
+            mem_limit = strtoul(optarg, NULL, 10) * 1024 * 1024;
+            break;
+         default:
+            fprintf(stderr, "Usage: %s [-f [-n top] [-m megabytes] [file...]]\n", argv[0]);
+            return 1;
+      }
+   }
+
+   if (freq)
+      return word_frequencies(argv + optind, argc - optind, top_n, mem_limit);
 
    printf("Enter some text (press CTRL+D to exit):\n\n");
+   fflush(stdout);
 
-   while ((character = getchar()) != EOF) {
-      ++num_chars;
-      if (character == '\n')
-         ++newlines;
-      if (character == ' ' || character == '\n' || character == '\t') {
-         state = OUT;
-      } else if (state == OUT) {
-         state = IN;
-         ++num_words;
+   while ((n = read(STDIN_FILENO, buf, sizeof(buf))) != 0) {
+      if (n == -1) {
+         if (errno == EINTR)
+            continue;
+         perror("Error reading input");
+         return 1;
       }
+      wc_count(buf, n, &counts);
    }
 
-   printf("Lines: %d\tWords: %d\tCharacters: %d\n", newlines, num_words, num_chars);
-   
+   printf("Lines: %ld\tWords: %ld\tCharacters: %ld\n", counts.newlines, counts.words, counts.chars);
+
    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,23 @@
+#include "wc_count.h"
+
+void wc_count(const char *buf, size_t len, struct wc_counts *c) {
+   int state = c->state;
+   long newlines = c->newlines, num_words = c->words;
+
+   for (size_t i = 0; i < len; ++i) {
+      char character = buf[i];
+      if (character == '\n')
+         ++newlines;
+      if (character == ' ' || character == '\n' || character == '\t') {
+         state = OUT;
+      } else if (state == OUT) {
+         state = IN;
+         ++num_words;
+      }
+   }
+
+   c->state = state;
+   c->newlines = newlines;
+   c->words = num_words;
+   c->chars += len;
+}
@@ -0,0 +1,19 @@
+#ifndef WC_COUNT_H
+#define WC_COUNT_H
+
+#include <stddef.h>
+
+#define     IN    1
+#define     OUT   0
+
+//Running totals; 'state' carries IN/OUT across calls so input can be fed in pieces
+struct wc_counts {
+   long newlines;
+   long words;
+   long chars;
+   int state;
+};
+
+void wc_count(const char *buf, size_t len, struct wc_counts *c);
+
+#endif
@@ -0,0 +1,424 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "word_freq.h"
+
+#define INITIAL_CAPACITY   1024
+#define ARENA_BLOCK        (1024 * 1024)
+#define MIN_ARENA_BLOCK    4096
+#define MIN_SKETCH_WIDTH   1024
+#define SKETCH_SHARE       8        //1/8 of the budget goes to the sketch
+
+//Same separators as wc_count()
+static int is_sep(char c) {
+   return c == ' ' || c == '\n' || c == '\t';
+}
+
+//Eight bytes per multiply: much faster than byte-at-a-time hashes on words
+static uint64_t hash_word(const char *s, size_t len) {
+   uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+   uint64_t v;
+
+   for (; len >= 8; s += 8, len -= 8) {
+      memcpy(&v, s, 8);
+      h = (h ^ v) * 0xBF58476D1CE4E5B9ULL;
+      h ^= h >> 31;
+   }
+   if (len > 0) {
+      v = 0;
+      memcpy(&v, s, len);
+      h = (h ^ v) * 0x94D049BB133111EBULL;
+   }
+   h ^= h >> 32;
+   h *= 0xD6E8FEB86659FD93ULL;
+   h ^= h >> 32;
+   return h;
+}
+
+static size_t sketch_bytes(const struct word_freq *wf) {
+   return wf->sketch_width * SKETCH_DEPTH * sizeof(uint32_t);
+}
+
+//Budget left for the exact table and arena
+static size_t exact_limit(const struct word_freq *wf) {
+   return wf->mem_limit ? wf->mem_limit - sketch_bytes(wf) : SIZE_MAX;
+}
+
+struct word_freq *word_freq_create(size_t mem_limit, size_t top_n) {
+   struct word_freq *wf = calloc(1, sizeof(*wf));
+   if (wf == NULL)
+      return NULL;
+
+   wf->mem_limit = mem_limit;
+   wf->top_n = top_n;
+   if (mem_limit) {
+      wf->sketch_width = MIN_SKETCH_WIDTH;
+      while (wf->sketch_width * 2 * SKETCH_DEPTH * sizeof(uint32_t) <= mem_limit / SKETCH_SHARE)
+         wf->sketch_width *= 2;
+      if (sketch_bytes(wf) >= mem_limit) {
+         free(wf);
+         errno = EINVAL;
+         return NULL;
+      }
+   }
+
+   wf->capacity = INITIAL_CAPACITY;
+   wf->table = calloc(wf->capacity, sizeof(*wf->table));
+   wf->candidates = calloc(top_n ? top_n : 1, sizeof(*wf->candidates));
+   if (wf->table == NULL || wf->candidates == NULL) {
+      word_freq_destroy(wf);
+      errno = ENOMEM;
+      return NULL;
+   }
+   wf->mem_used = wf->capacity * sizeof(*wf->table);
+   return wf;
+}
+
+void word_freq_destroy(struct word_freq *wf) {
+   struct arena_block *b, *next;
+
+   for (b = wf->arena; b != NULL; b = next) {
+      next = b->next;
+      free(b);
+   }
+   for (size_t i = 0; i < wf->ncandidates; ++i)
+      free(wf->candidates[i].word);
+   free(wf->candidates);
+   free(wf->sketch);
+   free(wf->table);
+   free(wf->carry);
+   free(wf);
+}
+
+//Bump-allocate from the arena; NULL with errno 0 when over budget
+static char *arena_alloc(struct word_freq *wf, size_t len) {
+   struct arena_block *b = wf->arena;
+
+   if (b == NULL || b->size - b->used < len) {
+      //Small budgets get small blocks, so words aren't refused early
+      size_t size = wf->mem_limit ? wf->mem_limit / 16 : ARENA_BLOCK;
+      if (size > ARENA_BLOCK)
+         size = ARENA_BLOCK;
+      if (size < MIN_ARENA_BLOCK)
+         size = MIN_ARENA_BLOCK;
+      if (size < len)
+         size = len;
+      if (wf->mem_used + size > exact_limit(wf)) {
+         errno = 0;
+         return NULL;
+      }
+      b = malloc(sizeof(*b) + size);
+      if (b == NULL) {
+         errno = ENOMEM;
+         return NULL;
+      }
+      b->size = size;
+      b->used = 0;
+      b->next = wf->arena;
+      wf->arena = b;
+      wf->mem_used += size;
+   }
+
+   char *p = b->data + b->used;
+   b->used += len;
+   return p;
+}
+
+static size_t find_slot(const struct word_freq *wf, uint64_t h, const char *word, size_t len) {
+   size_t mask = wf->capacity - 1;
+   size_t i = h & mask;
+
+   while (wf->table[i].word != NULL) {
+      const struct word_entry *e = &wf->table[i];
+      if (e->hash == h && e->len == len && memcmp(e->word, word, len) == 0)
+         break;
+      i = (i + 1) & mask;
+   }
+   return i;
+}
+
+//Double the table; returns -1 without changing anything if over budget
+static int grow(struct word_freq *wf) {
+   size_t cap = wf->capacity * 2;
+   size_t bytes = cap * sizeof(*wf->table);
+
+   //Both tables exist while rehashing
+   if (wf->mem_used + bytes > exact_limit(wf))
+      return -1;
+   struct word_entry *table = calloc(cap, sizeof(*table));
+   if (table == NULL)
+      return -1;
+
+   struct word_entry *old = wf->table;
+   size_t old_cap = wf->capacity;
+   wf->table = table;
+   wf->capacity = cap;
+   for (size_t i = 0; i < old_cap; ++i) {
+      if (old[i].word == NULL)
+         continue;
+      size_t j = old[i].hash & (cap - 1);
+      while (table[j].word != NULL)
+         j = (j + 1) & (cap - 1);
+      table[j] = old[i];
+   }
+   free(old);
+   wf->mem_used += bytes - old_cap * sizeof(*old);
+   return 0;
+}
+
+//Conservative update: only raise the counters that hold the minimum,
+//which keeps the overestimate for rare words much smaller
+static uint64_t sketch_add(struct word_freq *wf, uint64_t h) {
+   size_t idx[SKETCH_DEPTH];
+   uint64_t step = (h >> 32) | 1;
+   uint32_t est = UINT32_MAX;
+
+   for (int d = 0; d < SKETCH_DEPTH; ++d) {
+      idx[d] = d * wf->sketch_width + ((h + d * step) & (wf->sketch_width - 1));
+      if (wf->sketch[idx[d]] < est)
+         est = wf->sketch[idx[d]];
+   }
+   if (est == UINT32_MAX)
+      return est;
+   for (int d = 0; d < SKETCH_DEPTH; ++d)
+      if (wf->sketch[idx[d]] == est)
+         wf->sketch[idx[d]] = est + 1;
+   return est + 1;
+}
+
+static void candidate_swap(struct word_candidate *a, struct word_candidate *b) {
+   struct word_candidate t = *a;
+   *a = *b;
+   *b = t;
+}
+
+static void candidate_sift_down(struct word_freq *wf, size_t i) {
+   struct word_candidate *c = wf->candidates;
+
+   for (;;) {
+      size_t l = 2 * i + 1, r = l + 1, m = i;
+      if (l < wf->ncandidates && c[l].count < c[m].count)
+         m = l;
+      if (r < wf->ncandidates && c[r].count < c[m].count)
+         m = r;
+      if (m == i)
+         return;
+      candidate_swap(&c[i], &c[m]);
+      i = m;
+   }
+}
+
+static void candidate_sift_up(struct word_freq *wf, size_t i) {
+   struct word_candidate *c = wf->candidates;
+
+   while (i > 0 && c[(i - 1) / 2].count > c[i].count) {
+      candidate_swap(&c[i], &c[(i - 1) / 2]);
+      i = (i - 1) / 2;
+   }
+}
+
+//Count a word that didn't fit in the exact table
+static int add_overflow(struct word_freq *wf, uint64_t h, const char *word, size_t len) {
+   if (wf->sketch == NULL) {
+      wf->sketch = calloc(wf->sketch_width * SKETCH_DEPTH, sizeof(uint32_t));
+      if (wf->sketch == NULL) {
+         errno = ENOMEM;
+         return -1;
+      }
+   }
+   ++wf->overflow_words;
+   uint64_t est = sketch_add(wf, h);
+
+   for (size_t i = 0; i < wf->ncandidates; ++i) {
+      struct word_candidate *c = &wf->candidates[i];
+      if (c->hash == h && c->len == len && memcmp(c->word, word, len) == 0) {
+         c->count = est;
+         candidate_sift_down(wf, i);
+         return 0;
+      }
+   }
+
+   if (wf->top_n == 0 || (wf->ncandidates == wf->top_n && est <= wf->candidates[0].count))
+      return 0;
+
+   char *copy = malloc(len);
+   if (copy == NULL) {
+      errno = ENOMEM;
+      return -1;
+   }
+   memcpy(copy, word, len);
+
+   if (wf->ncandidates < wf->top_n) {
+      struct word_candidate c = {h, copy, len, est};
+      wf->candidates[wf->ncandidates] = c;
+      candidate_sift_up(wf, wf->ncandidates++);
+   } else {
+      struct word_candidate c = {h, copy, len, est};
+      free(wf->candidates[0].word);
+      wf->candidates[0] = c;
+      candidate_sift_down(wf, 0);
+   }
+   return 0;
+}
+
+int word_freq_add(struct word_freq *wf, const char *word, size_t len) {
+   uint64_t h = hash_word(word, len);
+   size_t i = find_slot(wf, h, word, len);
+
+   if (wf->table[i].word != NULL) {
+      ++wf->table[i].count;
+      return 0;
+   }
+
+   //Keep the load under 1/2 while we can grow, under 7/8 once frozen
+   if (!wf->frozen && (wf->distinct + 1) * 2 > wf->capacity) {
+      if (grow(wf) == -1)
+         wf->frozen = 1;
+      else
+         i = find_slot(wf, h, word, len);
+   }
+   if (wf->frozen && (wf->distinct + 1) * 8 > wf->capacity * 7)
+      return add_overflow(wf, h, word, len);
+
+   char *copy = arena_alloc(wf, len);
+   if (copy == NULL) {
+      if (errno != 0)
+         return -1;
+      wf->frozen = 1;
+      return add_overflow(wf, h, word, len);
+   }
+   memcpy(copy, word, len);
+
+   struct word_entry e = {h, copy, 1, len};
+   wf->table[i] = e;
+   ++wf->distinct;
+   return 0;
+}
+
+static int carry_append(struct word_freq *wf, const char *s, size_t len) {
+   if (wf->carry_len + len > wf->carry_cap) {
+      size_t cap = wf->carry_cap ? wf->carry_cap : 64;
+      while (cap < wf->carry_len + len)
+         cap *= 2;
+      char *p = realloc(wf->carry, cap);
+      if (p == NULL) {
+         errno = ENOMEM;
+         return -1;
+      }
+      wf->carry = p;
+      wf->carry_cap = cap;
+   }
+   memcpy(wf->carry + wf->carry_len, s, len);
+   wf->carry_len += len;
+   return 0;
+}
+
+//Split 'buf' into words and count them. A word running off the end of
+//'buf' is held back until the next call or word_freq_finish().
+int word_freq_feed(struct word_freq *wf, const char *buf, size_t len) {
+   size_t i = 0;
+
+   if (wf->carry_len > 0) {
+      while (i < len && !is_sep(buf[i]))
+         ++i;
+      if (carry_append(wf, buf, i) == -1)
+         return -1;
+      if (i == len)
+         return 0;
+      if (word_freq_add(wf, wf->carry, wf->carry_len) == -1)
+         return -1;
+      wf->carry_len = 0;
+   }
+
+   while (i < len) {
+      while (i < len && is_sep(buf[i]))
+         ++i;
+      size_t start = i;
+      while (i < len && !is_sep(buf[i]))
+         ++i;
+      if (i == start)
+         break;
+      if (i == len)
+         return carry_append(wf, buf + start, i - start);
+      if (word_freq_add(wf, buf + start, i - start) == -1)
+         return -1;
+   }
+   return 0;
+}
+
+int word_freq_finish(struct word_freq *wf) {
+   if (wf->carry_len == 0)
+      return 0;
+   int r = word_freq_add(wf, wf->carry, wf->carry_len);
+   wf->carry_len = 0;
+   return r;
+}
+
+//Orders by count, then puts alphabetically earlier words first
+static int count_less(const struct word_count *a, const struct word_count *b) {
+   if (a->count != b->count)
+      return a->count < b->count;
+   size_t n = a->len < b->len ? a->len : b->len;
+   int c = memcmp(a->word, b->word, n);
+   return c != 0 ? c > 0 : a->len > b->len;
+}
+
+static void heap_push(struct word_count *heap, size_t *n, size_t max, struct word_count wc) {
+   size_t i;
+
+   if (*n < max) {
+      i = (*n)++;
+      heap[i] = wc;
+      while (i > 0 && count_less(&heap[i], &heap[(i - 1) / 2])) {
+         struct word_count t = heap[i];
+         heap[i] = heap[(i - 1) / 2];
+         heap[(i - 1) / 2] = t;
+         i = (i - 1) / 2;
+      }
+      return;
+   }
+   if (max == 0 || !count_less(&heap[0], &wc))
+      return;
+
+   heap[0] = wc;
+   for (i = 0;;) {
+      size_t l = 2 * i + 1, r = l + 1, m = i;
+      if (l < *n && count_less(&heap[l], &heap[m]))
+         m = l;
+      if (r < *n && count_less(&heap[r], &heap[m]))
+         m = r;
+      if (m == i)
+         break;
+      struct word_count t = heap[i];
+      heap[i] = heap[m];
+      heap[m] = t;
+      i = m;
+   }
+}
+
+static int count_cmp_desc(const void *a, const void *b) {
+   const struct word_count *x = a, *y = b;
+   return count_less(x, y) - count_less(y, x);
+}
+
+//Fill 'out' (room for top_n entries) with the most frequent words, most
+//frequent first. Words counted only by the sketch are marked approximate.
+size_t word_freq_top(struct word_freq *wf, struct word_count *out) {
+   size_t n = 0;
+
+   for (size_t i = 0; i < wf->capacity; ++i) {
+      const struct word_entry *e = &wf->table[i];
+      if (e->word != NULL) {
+         struct word_count wc = {e->word, e->len, e->count, 0};
+         heap_push(out, &n, wf->top_n, wc);
+      }
+   }
+   for (size_t i = 0; i < wf->ncandidates; ++i) {
+      const struct word_candidate *c = &wf->candidates[i];
+      struct word_count wc = {c->word, c->len, c->count, 1};
+      heap_push(out, &n, wf->top_n, wc);
+   }
+
+   qsort(out, n, sizeof(*out), count_cmp_desc);
+   return n;
+}
@@ -0,0 +1,76 @@
+#ifndef WORD_FREQ_H
+#define WORD_FREQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SKETCH_DEPTH   4
+
+//One distinct word; 'word' points into the arena and is not NUL-terminated
+struct word_entry {
+   uint64_t hash;
+   const char *word;
+   uint64_t count;
+   uint32_t len;
+};
+
+struct arena_block {
+   struct arena_block *next;
+   size_t used;
+   size_t size;
+   char data[];
+};
+
+//Heavy-hitter candidate among words only counted in the sketch
+struct word_candidate {
+   uint64_t hash;
+   char *word;
+   uint32_t len;
+   uint64_t count;            //Sketch estimate, an upper bound
+};
+
+struct word_count {
+   const char *word;
+   size_t len;
+   uint64_t count;
+   int approximate;
+};
+
+//Exact counts in an open-addressing table whose words live in an arena.
+//Once the memory budget is spent, words not already in the table are
+//counted in a count-min sketch instead, and the most frequent of those
+//are tracked as candidates for the top N.
+struct word_freq {
+   size_t mem_limit;          //0 for unlimited
+   size_t mem_used;           //Table + arena blocks
+   size_t top_n;
+
+   struct word_entry *table;
+   size_t capacity;           //Power of two
+   size_t distinct;
+   int frozen;                //Table can't grow any more
+
+   struct arena_block *arena;
+
+   uint32_t *sketch;          //SKETCH_DEPTH rows of 'sketch_width' counters
+   size_t sketch_width;       //Power of two
+   uint64_t overflow_words;   //Occurrences counted only in the sketch
+
+   struct word_candidate *candidates;   //Min-heap on count
+   size_t ncandidates;
+
+   char *carry;               //Word split across feed() calls
+   size_t carry_len;
+   size_t carry_cap;
+};
+
+struct word_freq *word_freq_create(size_t mem_limit, size_t top_n);
+void word_freq_destroy(struct word_freq *wf);
+
+int word_freq_add(struct word_freq *wf, const char *word, size_t len);
+int word_freq_feed(struct word_freq *wf, const char *buf, size_t len);
+int word_freq_finish(struct word_freq *wf);
+
+size_t word_freq_top(struct word_freq *wf, struct word_count *out);
+
+#endif